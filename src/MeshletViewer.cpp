@@ -6,10 +6,12 @@
 #include "meshlets/sites/RandomSites.h"
 #include "meshlets/clustering/GrowSites.h"
 #include "meshlets/clustering/BruteForceClustering.h"
+#include "meshlets/clustering/SitePositions.h"
 #include "meshlets/clustering/Lloyd.h"
 #include "meshlets/visualization/ShowSites.h"
 #include "meshlets/visualization/ShowMeshlets.h"
 #include "meshlets/LOD/LOD.h"
+#include "meshlets/MeshletBounds.h"
 
 #include <imgui.h>
 
@@ -35,12 +37,21 @@ pmp::vec3 MeshletViewer::get_camera_position()
     return pmp::vec3(inverse_mw(0, 3), inverse_mw(1, 3), inverse_mw(2, 3));
 }
 
+float MeshletViewer::get_projection_scale()
+{
+    return 0.5f * height() / std::tan(0.5f * fovy_ * M_PI / 180.0f);
+}
+
 void MeshletViewer::handle_lod()
 {
     auto camera_position = get_camera_position();
-    meshlets::color_lod(mesh_, lod_tree, camera_position,
-                        currently_visible_nodes);
-    update_mesh();
+    // only upload the mesh again if the visible nodes changed
+    if (meshlets::color_lod(mesh_, lod_tree, camera_position,
+                            get_projection_scale(), max_pixel_error,
+                            lod_selection))
+    {
+        update_mesh();
+    }
 }
 
 void MeshletViewer::scroll(double xoffset, double yoffset)
@@ -219,25 +230,26 @@ void MeshletViewer::process_imgui()
             int total = cluster_and_sites.cluster.size();
 
             meshlets::Cluster cluster_with_only_invalid_meshlets;
-            cluster_with_only_invalid_meshlets.reserve(total);
 
             auto start = std::chrono::high_resolution_clock::now();
-            for (auto &meshlet : cluster_and_sites.cluster)
+            auto valid = meshlets::validate_meshlets(mesh_,
+                                                     cluster_and_sites.cluster);
+            for (int meshlet_id = 0; meshlet_id < total; meshlet_id++)
             {
-                if (meshlets::is_valid(mesh_, *meshlet))
+                auto meshlet = cluster_and_sites.cluster[meshlet_id];
+                if (valid[meshlet_id])
                 {
                     num_valid++;
                 }
                 else
                 {
-                    cluster_with_only_invalid_meshlets.push_back(
-                        std::make_shared<meshlets::Meshlet>(*meshlet));
+                    cluster_with_only_invalid_meshlets.push_back(meshlet);
                 }
             }
             auto end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed = end - start;
             std::clog << "Validating Meshlets took: " << elapsed.count()
-                      << std::endl;
+                      << " s" << std::endl;
 
             std::cout << "Valid Meshlets: " << num_valid << "/" << total << " ("
                       << ((float)num_valid / (float)total) * 100 << "%)"
@@ -382,6 +394,104 @@ void MeshletViewer::process_imgui()
 
         ImGui::Spacing();
 
+        if (ImGui::Button("Priority Grow Sites"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            cluster_and_sites.cluster = meshlets::grow_sites_priority(
+                mesh_, cluster_and_sites.sites, max_iterations);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "Growing Sites by priority took: " << elapsed.count()
+                      << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        static meshlets::MeshletLimits meshlet_limits;
+        ImGui::InputInt("Max Meshlet Vertices", &meshlet_limits.max_vertices);
+        ImGui::InputInt("Max Meshlet Triangles",
+                        &meshlet_limits.max_triangles);
+        meshlet_limits.max_vertices = std::max(meshlet_limits.max_vertices, 3);
+        meshlet_limits.max_triangles =
+            std::max(meshlet_limits.max_triangles, 1);
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Constrained Grow Sites"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            cluster_and_sites = meshlets::grow_sites_constrained(
+                mesh_, cluster_and_sites.sites, meshlet_limits);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "Constrained Growing Sites took: " << elapsed.count()
+                      << " s (" << cluster_and_sites.cluster.size()
+                      << " meshlets)" << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        static int num_threads = 1;
+        ImGui::InputInt("Number of Threads (0: all)", &num_threads);
+        num_threads = std::max(num_threads, 0);
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Parallel Grow Sites"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            cluster_and_sites.cluster = meshlets::grow_sites_parallel(
+                mesh_, cluster_and_sites.sites, max_iterations, num_threads);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "Growing Sites in parallel took: " << elapsed.count()
+                      << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
         if (ImGui::Button("Brute Force Clustering"))
         {
             if (lod_enabled)
@@ -399,8 +509,9 @@ void MeshletViewer::process_imgui()
             }
 
             auto start = std::chrono::high_resolution_clock::now();
-            cluster_and_sites.cluster =
-                meshlets::brute_force_sites(mesh_, cluster_and_sites.sites);
+            cluster_and_sites.cluster = meshlets::brute_force_sites(
+                mesh_, cluster_and_sites.sites,
+                meshlets::NearestSiteSearch::Linear, num_threads);
             auto end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed = end - start;
             std::cout << "Brute Force Clustering took: " << elapsed.count()
@@ -409,8 +520,72 @@ void MeshletViewer::process_imgui()
 
         ImGui::Spacing();
 
+        if (ImGui::Button("KD-Tree Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            cluster_and_sites.cluster = meshlets::brute_force_sites(
+                mesh_, cluster_and_sites.sites,
+                meshlets::NearestSiteSearch::KdTree, num_threads);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "KD-Tree Clustering took: " << elapsed.count()
+                      << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("SIMD Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            cluster_and_sites.cluster = meshlets::brute_force_sites(
+                mesh_, cluster_and_sites.sites,
+                meshlets::NearestSiteSearch::Simd, num_threads);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "SIMD Clustering ("
+                      << meshlets::SitePositions::kernel_name()
+                      << ") took: " << elapsed.count() << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
         static int max_lloyd_iterations = 100;
         ImGui::InputInt("Max Lloyd Iterations", &max_lloyd_iterations);
+        static bool lloyd_area_weighted = false;
+        ImGui::Checkbox("Area Weighted Lloyd Centers", &lloyd_area_weighted);
+        static bool lloyd_warm_start = false;
+        ImGui::Checkbox("Warm Start Lloyd", &lloyd_warm_start);
+        auto lloyd_center = lloyd_area_weighted
+                                ? meshlets::LloydCenter::AreaWeightedMean
+                                : meshlets::LloydCenter::Median;
 
         ImGui::Spacing();
 
@@ -431,8 +606,10 @@ void MeshletViewer::process_imgui()
             }
 
             auto start = std::chrono::high_resolution_clock::now();
-            cluster_and_sites = meshlets::lloyd(mesh_, cluster_and_sites.sites,
-                                                max_lloyd_iterations);
+            cluster_and_sites =
+                meshlets::lloyd(mesh_, cluster_and_sites.sites,
+                                max_lloyd_iterations, lloyd_center,
+                                lloyd_warm_start, num_threads);
             auto end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed = end - start;
             std::cout << "Lloyd Relaxation took: " << elapsed.count() << " s" << std::endl;
@@ -447,6 +624,10 @@ void MeshletViewer::process_imgui()
         static int benchmark_iterations = 1000;
         ImGui::InputInt("Benchmark Iterations", &benchmark_iterations);
 
+        static int benchmark_threads = 1;
+        ImGui::InputInt("Benchmark Threads (0: all)", &benchmark_threads);
+        benchmark_threads = std::max(benchmark_threads, 0);
+
         if (ImGui::Button("Benchmark GS-Clustering"))
         {
             if (lod_enabled)
@@ -477,6 +658,67 @@ void MeshletViewer::process_imgui()
 
         ImGui::Spacing();
 
+        if (ImGui::Button("Benchmark PQ-Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                meshlets::grow_sites_priority(mesh_, cluster_and_sites.sites);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed =
+                (end - start) / benchmark_iterations;
+            std::cout << "Mean PQ-Clustering over " << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Benchmark PGS-Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                meshlets::grow_sites_parallel(mesh_, cluster_and_sites.sites,
+                                              1000, benchmark_threads);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed =
+                (end - start) / benchmark_iterations;
+            std::cout << "Mean PGS-Clustering over " << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
         if (ImGui::Button("Benchmark BF-Clustering"))
         {
             if (lod_enabled)
@@ -496,7 +738,9 @@ void MeshletViewer::process_imgui()
             auto start = std::chrono::high_resolution_clock::now();
             for (int i = 0; i < benchmark_iterations; i++)
             {
-                meshlets::brute_force_sites(mesh_, cluster_and_sites.sites);
+                meshlets::brute_force_sites(
+                    mesh_, cluster_and_sites.sites,
+                    meshlets::NearestSiteSearch::Linear, benchmark_threads);
             }
             auto end = std::chrono::high_resolution_clock::now();
             std::chrono::duration<double> elapsed =
@@ -504,6 +748,219 @@ void MeshletViewer::process_imgui()
             std::cout << "Mean BF-Clustering over " << benchmark_iterations
                       << " iterations: " << elapsed.count() << " s" << std::endl;
         }
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Benchmark KD-Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+            
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                meshlets::brute_force_sites(
+                    mesh_, cluster_and_sites.sites,
+                    meshlets::NearestSiteSearch::KdTree, benchmark_threads);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed =
+                (end - start) / benchmark_iterations;
+            std::cout << "Mean KD-Clustering over " << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s" << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Benchmark SIMD-Clustering"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+            
+            // compare all kernels the CPU supports (the scalar one is the fallback of other CPUs)
+            for (auto kernel : {"scalar", "sse2", "avx2"})
+            {
+                if (!meshlets::SitePositions::set_kernel(kernel))
+                {
+                    continue;
+                }
+                auto start = std::chrono::high_resolution_clock::now();
+                for (int i = 0; i < benchmark_iterations; i++)
+                {
+                    meshlets::brute_force_sites(
+                        mesh_, cluster_and_sites.sites,
+                        meshlets::NearestSiteSearch::Simd, benchmark_threads);
+                }
+                auto end = std::chrono::high_resolution_clock::now();
+                std::chrono::duration<double> elapsed =
+                    (end - start) / benchmark_iterations;
+                std::clog << "Mean SIMD-Clustering ("
+                          << meshlets::SitePositions::kernel_name()
+                          << ") over " << benchmark_iterations
+                          << " iterations: " << elapsed.count() << " s"
+                          << std::endl;
+            }
+            meshlets::SitePositions::set_kernel("auto");
+            std::cout << "SIMD-Clustering benchmark of all kernels written to "
+                         "the console"
+                      << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        static int benchmark_lloyd_iterations = 10;
+        ImGui::InputInt("Benchmark Lloyd Iterations",
+                        &benchmark_lloyd_iterations);
+
+        if (ImGui::Button("Benchmark Lloyd"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            if (cluster_and_sites.sites.empty())
+            {
+                std::cerr << "No sites generated. Please generate sites first."
+                          << std::endl;
+                return;
+            }
+
+            // lloyd moves the sites in f:is_site, they are restored after each run
+            auto is_site = mesh_.get_face_property<bool>("f:is_site");
+            assert(is_site);
+            for (auto center : {meshlets::LloydCenter::Median,
+                                meshlets::LloydCenter::AreaWeightedMean})
+            {
+                for (bool warm_start : {false, true})
+                {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    for (int i = 0; i < benchmark_iterations; i++)
+                    {
+                        auto result = meshlets::lloyd(
+                            mesh_, cluster_and_sites.sites,
+                            benchmark_lloyd_iterations, center, warm_start,
+                            benchmark_threads);
+                        for (auto &site : result.sites)
+                        {
+                            is_site[site.face] = false;
+                        }
+                        for (auto &site : cluster_and_sites.sites)
+                        {
+                            is_site[site.face] = true;
+                        }
+                    }
+                    auto end = std::chrono::high_resolution_clock::now();
+                    std::chrono::duration<double> elapsed =
+                        (end - start) / benchmark_iterations;
+                    std::cout << "Mean Lloyd ("
+                              << (center == meshlets::LloydCenter::Median
+                                      ? "median"
+                                      : "area weighted mean")
+                              << (warm_start ? ", warm start" : "")
+                              << ") over " << benchmark_iterations
+                              << " iterations: " << elapsed.count() << " s"
+                              << std::endl;
+                }
+            }
+        }
+
+        if (ImGui::Button("Benchmark Validation"))
+        {
+            if (lod_enabled)
+            {
+                std::cerr << "LOD is enabled. Please disable LOD first."
+                          << std::endl;
+                return;
+            }
+            if (cluster_and_sites.cluster.empty())
+            {
+                std::cerr << "No meshlets generated. Please generate meshlets "
+                             "first."
+                          << std::endl;
+                return;
+            }
+
+            // per meshlet check (adjacency queries in the inner loops)
+            auto &cluster = cluster_and_sites.cluster;
+            size_t num_valid = 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                num_valid = 0;
+                for (size_t meshlet_id = 0; meshlet_id < cluster.size();
+                     meshlet_id++)
+                {
+                    num_valid += meshlets::is_valid(mesh_, cluster[meshlet_id]);
+                }
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed =
+                (end - start) / benchmark_iterations;
+            std::cout << "Mean Validation (per meshlet) over "
+                      << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s ("
+                      << num_valid << " valid)" << std::endl;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                meshlets::validate_meshlets(mesh_, cluster);
+            }
+            end = std::chrono::high_resolution_clock::now();
+            elapsed = (end - start) / benchmark_iterations;
+            std::cout << "Mean Validation (single pass) over "
+                      << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s"
+                      << std::endl;
+        }
+
+        if (ImGui::Button("Benchmark Meshlet Bounds"))
+        {
+            if (cluster_and_sites.cluster.empty())
+            {
+                std::cerr << "No meshlets generated. Please generate meshlets "
+                             "first."
+                          << std::endl;
+                return;
+            }
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < benchmark_iterations; i++)
+            {
+                meshlets::compute_meshlet_bounds(
+                    mesh_, cluster_and_sites.cluster, benchmark_threads);
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed =
+                (end - start) / benchmark_iterations;
+            std::cout << "Mean Meshlet Bounds over " << benchmark_iterations
+                      << " iterations: " << elapsed.count() << " s" << std::endl;
+        }
     }
 
     ImGui::Spacing();
@@ -523,6 +980,17 @@ void MeshletViewer::process_imgui()
         ImGui::SliderInt("Number of Levels for LOD Tree", &num_levels,
                          min_levels, max_levels, "%d");
 
+        static int lod_threads = 1;
+        ImGui::InputInt("LOD Build Threads (0: all)", &lod_threads);
+        lod_threads = std::max(lod_threads, 0);
+
+        if (ImGui::SliderFloat("Max Pixel Error", &max_pixel_error, 0.1f,
+                               20.0f, "%.1f") &&
+            lod_enabled)
+        {
+            handle_lod();
+        }
+
         ImGui::Spacing();
 
         if (ImGui::Button("Toggle LOD"))
@@ -534,21 +1002,40 @@ void MeshletViewer::process_imgui()
             if (lod_enabled)
             {
                 lod_enabled = false;
-                lod_tree = meshlets::TreeNode();
-                currently_visible_nodes.clear();
+                lod_tree.clear();
+                lod_selection = meshlets::LodSelection();
+                mesh_ = lod_input_mesh;
+                lod_input_mesh.clear();
+                update_mesh();
                 std::cout << "LOD disabled" << std::endl;
             }
             else
             {
                 auto start = std::chrono::high_resolution_clock::now();
                 lod_tree =
-                    meshlets::build_lod_tree(mesh_, num_levels, num_sites);
+                    meshlets::build_lod_tree(mesh_, num_levels, num_sites,
+                                             lod_threads);
                 auto end = std::chrono::high_resolution_clock::now();
                 std::chrono::duration<double> elapsed = end - start;
                 std::clog << "Building LOD Tree took: " << elapsed.count()
                           << " s" << std::endl;
+                for (int lod_level = 0; lod_level < num_levels; lod_level++)
+                {
+                    size_t num_faces = 0;
+                    float max_error = 0.0f;
+                    auto nodes = meshlets::get_nodes(lod_tree, lod_level);
+                    for (auto node : nodes)
+                    {
+                        num_faces += lod_tree.faces(node).size();
+                        max_error = std::max(max_error, lod_tree.error[node]);
+                    }
+                    std::clog << "Level " << lod_level << ": " << nodes.size()
+                              << " nodes, " << num_faces
+                              << " faces, max error " << max_error
+                              << std::endl;
+                }
                 // check if lod_tree is valid
-                if (lod_tree.children->size() == 0)
+                if (lod_tree.n_levels() < 2)
                 {
                     std::cout << "Tree-Nodes are too small, please try another "
                                  "parameter configuration"
@@ -559,18 +1046,15 @@ void MeshletViewer::process_imgui()
                 {
                     std::cout << "LOD enabled" << std::endl;
                     lod_enabled = true;
+                    // mesh_ is replaced by the faces of the visible nodes
+                    lod_input_mesh = mesh_;
                     set_draw_mode("Smooth Shading");
                     renderer_.set_shininess(0);
                     renderer_.set_specular(0);
                     renderer_.set_diffuse(0);
-                    // fill initially visible nodes with highest level
-                    currently_visible_nodes =
-                        meshlets::get_nodes(lod_tree, num_levels - 1);
-                    // color it
-                    auto camera_position = get_camera_position();
-                    meshlets::color_lod(mesh_, lod_tree, camera_position,
-                                        currently_visible_nodes);
-                    update_mesh();
+                    // select the visible nodes for the current camera and color them
+                    lod_selection = meshlets::LodSelection();
+                    handle_lod();
                 }
             }
         }
@@ -595,12 +1079,99 @@ void MeshletViewer::process_imgui()
             }
 
             meshlets::color_level(mesh_, lod_tree, level);
+            // the mesh no longer shows the selected nodes, the next camera update extracts them again
+            lod_selection.nodes.clear();
             update_mesh();
             set_draw_mode("Smooth Shading");
             renderer_.set_shininess(0);
             renderer_.set_specular(0);
             renderer_.set_diffuse(0);
         }
+
+        ImGui::Spacing();
+
+        if (ImGui::Button("Benchmark LOD Bounds"))
+        {
+            if (!lod_enabled)
+            {
+                std::cerr << "LOD is not enabled. Please enable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            size_t num_nodes = lod_tree.size();
+            auto start = std::chrono::high_resolution_clock::now();
+            for (size_t node = 0; node < num_nodes; node++)
+            {
+                meshlets::compute_bounds(lod_tree.meshes[lod_tree.level[node]],
+                                         lod_tree.faces(node));
+            }
+            auto end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> elapsed = end - start;
+            std::cout << "Bounds of " << num_nodes
+                      << " LOD nodes took: " << elapsed.count() << " s"
+                      << std::endl;
+        }
+
+        ImGui::Spacing();
+
+        static int selection_updates = 1000;
+        ImGui::InputInt("Benchmark Selection Updates", &selection_updates);
+        selection_updates = std::max(selection_updates, 1);
+
+        if (ImGui::Button("Benchmark LOD Selection"))
+        {
+            if (!lod_enabled)
+            {
+                std::cerr << "LOD is not enabled. Please enable LOD first."
+                          << std::endl;
+                return;
+            }
+
+            // orbit the camera around the mesh while moving closer, like a user dragging the view
+            auto center = lod_tree.lod_center[0];
+            auto radius = lod_tree.lod_radius[0];
+            auto projection_scale = get_projection_scale();
+            meshlets::LodSelection selection;
+            std::vector<unsigned char> was_selected(lod_tree.size(), false);
+            size_t num_selected = 0;
+            size_t num_changed = 0;
+            std::chrono::duration<double> elapsed(0);
+            for (int update = 0; update < selection_updates; update++)
+            {
+                float t = static_cast<float>(update) / selection_updates;
+                float angle = 4.0f * M_PI * t;
+                float distance = radius * (4.0f - 3.5f * t);
+                pmp::Point camera_position =
+                    center + distance * pmp::Point(std::cos(angle), 0.2f,
+                                                   std::sin(angle));
+
+                auto start = std::chrono::high_resolution_clock::now();
+                meshlets::select_lod_nodes(lod_tree, camera_position,
+                                           projection_scale, max_pixel_error,
+                                           selection);
+                auto end = std::chrono::high_resolution_clock::now();
+                elapsed += end - start;
+
+                // count the nodes that appeared since the last update
+                num_selected += selection.nodes.size();
+                for (auto node : selection.nodes)
+                {
+                    num_changed += !was_selected[node];
+                }
+                std::fill(was_selected.begin(), was_selected.end(), false);
+                for (auto node : selection.nodes)
+                {
+                    was_selected[node] = true;
+                }
+            }
+            std::cout << "Mean LOD Selection over " << selection_updates
+                      << " camera updates: " << elapsed.count() * 1e6 /
+                                                    selection_updates
+                      << " us (" << num_selected / selection_updates
+                      << " nodes, " << num_changed / selection_updates
+                      << " new per update)" << std::endl;
+        }
     }
 
     ImGui::Spacing();
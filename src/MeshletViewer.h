@@ -6,6 +6,7 @@
 #include <memory>
 #include <pmp/visualization/mesh_viewer.h>
 #include "meshlets/Meshlets.h"
+#include "meshlets/LOD/LOD.h"
 
 // =======================================================================
 // =========== Code generated by Github Copilot on 30.11.2023 ============
@@ -57,6 +58,8 @@ public:
 
     // calculates the camera position from the inverse modelview matrix
     pmp::vec3 get_camera_position();
+    // calculates the pixels per unit length at distance 1 from the viewport height and the field of view
+    float get_projection_scale();
 
 protected:
     // this function handles keyboard events
@@ -75,9 +78,13 @@ private:
     // boolean flag to indicate if LOD pipeline is enabled
     bool lod_enabled = false;
     // the LOD tree
-    meshlets::TreeNode lod_tree;
+    meshlets::LodTree lod_tree;
     // the currently visible nodes
-    std::vector<meshlets::TreeNode> currently_visible_nodes;
+    meshlets::LodSelection lod_selection;
+    // the largest error in pixels that is shown without refining a LOD node
+    float max_pixel_error = 2.0f;
+    // the input mesh, while LOD is enabled mesh_ holds the simplified faces of the visible nodes
+    pmp::SurfaceMesh lod_input_mesh;
 
     // handles everything that happens when lod_enabled is set to true
     void handle_lod();
@@ -0,0 +1,644 @@
+// Copyright 2011-2021 the Polygon Mesh Processing Library developers.
+// Distributed under a MIT-style license, see LICENSE.txt for details.
+
+#include "meshlets/Meshlets.h"
+#include "meshlets/sites/PoissonDiskRandom.h"
+#include "meshlets/sites/RandomSites.h"
+#include "meshlets/clustering/GrowSites.h"
+#include "meshlets/clustering/BruteForceClustering.h"
+#include "meshlets/clustering/SitePositions.h"
+#include "meshlets/clustering/Lloyd.h"
+#include "meshlets/export/MeshletExport.h"
+#include "meshlets/export/MeshletOptimization.h"
+
+#include "pmp/io/io.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace {
+// settings of a single bake, filled from the command line
+struct BakeOptions
+{
+    std::string input;
+    std::string output;
+    // GPU-ready binary meshlet buffers, empty if not requested
+    std::string export_file;
+    // reorder the exported triangles and meshlets for vertex reuse and locality
+    bool optimize_export = false;
+    // size limits of the exported meshlets, larger meshlets are split
+    meshlets::MeshletLimits export_limits{256, 256};
+    std::string site_generator = "random";
+    std::string clustering = "grow";
+    // nearest site kernel of the simd clustering ("auto" picks the fastest one of the CPU)
+    std::string simd_kernel = "auto";
+    // number of sites, if 0 the site ratio is used
+    int num_sites = 0;
+    // number of sites relative to the number of faces (same default as the viewer)
+    float site_ratio = 0.005f;
+    int max_iterations = 1000;
+    int max_lloyd_iterations = 100;
+    // point each lloyd site is moved towards ("median" or "mean")
+    std::string lloyd_center = "median";
+    // only regrow the meshlets around moved sites between lloyd iterations
+    bool lloyd_warm_start = false;
+    // size limits of the constrained clustering
+    meshlets::MeshletLimits limits;
+    bool fix_meshlets = true;
+    // number of threads (0: all hardware threads)
+    int num_threads = 1;
+    // number of timed clustering runs, 0 disables benchmarking
+    int benchmark_iterations = 0;
+};
+
+void print_usage(const char *program)
+{
+    std::cerr
+        << "Usage: " << program << " [options] <input mesh> <output file>\n"
+        << "\n"
+        << "Options:\n"
+        << "  --sites <n>             number of sites (default: faces * "
+           "site-ratio)\n"
+        << "  --site-ratio <r>        number of sites per face (default: "
+           "0.005)\n"
+        << "  --site-generator <g>    random | pds (default: random)\n"
+        << "  --clustering <c>        grow | parallel-grow | priority-grow | "
+           "constrained | bruteforce | kdtree | simd | lloyd (default: "
+           "grow)\n"
+        << "  --simd-kernel <k>       auto | avx2 | sse2 | scalar, kernel of "
+           "the simd clustering (default: auto)\n"
+        << "  --max-iterations <n>    max iterations for growing (default: "
+           "1000)\n"
+        << "  --lloyd-iterations <n>  max lloyd iterations (default: 100)\n"
+        << "  --lloyd-center <c>      median | mean (area weighted) "
+           "(default: median)\n"
+        << "  --lloyd-warm-start      only regrow the meshlets around moved "
+           "sites between lloyd iterations\n"
+        << "  --max-vertices <n>      max vertices per meshlet for "
+           "constrained (default: 64)\n"
+        << "  --max-triangles <n>     max triangles per meshlet for "
+           "constrained (default: 124)\n"
+        << "  --no-fix                skip validating and fixing the "
+           "meshlets (always skipped for constrained)\n"
+        << "  --threads <n>           number of threads, 0 uses all "
+           "(default: 1)\n"
+        << "  --benchmark <n>         report the mean time of n clustering, "
+           "validation and fixing runs (simd: for every supported kernel)\n"
+        << "  --export <file>         also write the meshlets as GPU-ready "
+           "binary buffers\n"
+        << "  --optimize              reorder the exported triangles (Tipsify) "
+           "and meshlets (Morton order)\n"
+        << "  --export-vertices <n>   max vertices per exported meshlet, "
+           "larger meshlets are split (at most 256, default: 256)\n"
+        << "  --export-triangles <n>  max triangles per exported meshlet, "
+           "larger meshlets are split (default: 256)\n"
+        << "\n"
+        << "The output file contains one line per face holding the id of "
+           "the meshlet the face belongs to.\n";
+}
+
+bool parse_options(int argc, char **argv, BakeOptions &options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool has_value = i + 1 < argc;
+
+        if (arg == "--no-fix")
+        {
+            options.fix_meshlets = false;
+        }
+        else if (arg == "--optimize")
+        {
+            options.optimize_export = true;
+        }
+        else if (arg == "--sites" && has_value)
+        {
+            options.num_sites = std::stoi(argv[++i]);
+        }
+        else if (arg == "--site-ratio" && has_value)
+        {
+            options.site_ratio = std::stof(argv[++i]);
+        }
+        else if (arg == "--site-generator" && has_value)
+        {
+            options.site_generator = argv[++i];
+        }
+        else if (arg == "--clustering" && has_value)
+        {
+            options.clustering = argv[++i];
+        }
+        else if (arg == "--simd-kernel" && has_value)
+        {
+            options.simd_kernel = argv[++i];
+        }
+        else if (arg == "--max-iterations" && has_value)
+        {
+            options.max_iterations = std::stoi(argv[++i]);
+        }
+        else if (arg == "--lloyd-iterations" && has_value)
+        {
+            options.max_lloyd_iterations = std::stoi(argv[++i]);
+        }
+        else if (arg == "--lloyd-warm-start")
+        {
+            options.lloyd_warm_start = true;
+        }
+        else if (arg == "--lloyd-center" && has_value)
+        {
+            options.lloyd_center = argv[++i];
+        }
+        else if (arg == "--max-vertices" && has_value)
+        {
+            options.limits.max_vertices = std::stoi(argv[++i]);
+        }
+        else if (arg == "--max-triangles" && has_value)
+        {
+            options.limits.max_triangles = std::stoi(argv[++i]);
+        }
+        else if (arg == "--threads" && has_value)
+        {
+            options.num_threads = std::max(std::stoi(argv[++i]), 0);
+        }
+        else if (arg == "--export" && has_value)
+        {
+            options.export_file = argv[++i];
+        }
+        else if (arg == "--export-vertices" && has_value)
+        {
+            options.export_limits.max_vertices = std::stoi(argv[++i]);
+        }
+        else if (arg == "--export-triangles" && has_value)
+        {
+            options.export_limits.max_triangles = std::stoi(argv[++i]);
+        }
+        else if (arg == "--benchmark" && has_value)
+        {
+            options.benchmark_iterations = std::stoi(argv[++i]);
+        }
+        else if (arg.rfind("--", 0) == 0)
+        {
+            std::cerr << "Unknown or incomplete option: " << arg << std::endl;
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2)
+    {
+        return false;
+    }
+    options.input = positional[0];
+    options.output = positional[1];
+
+    if (options.site_generator != "random" && options.site_generator != "pds")
+    {
+        std::cerr << "Unknown site generator: " << options.site_generator
+                  << std::endl;
+        return false;
+    }
+    if (options.clustering != "grow" &&
+        options.clustering != "parallel-grow" &&
+        options.clustering != "priority-grow" &&
+        options.clustering != "constrained" &&
+        options.clustering != "bruteforce" &&
+        options.clustering != "kdtree" && options.clustering != "simd" &&
+        options.clustering != "lloyd")
+    {
+        std::cerr << "Unknown clustering: " << options.clustering << std::endl;
+        return false;
+    }
+    if (!meshlets::SitePositions::set_kernel(options.simd_kernel))
+    {
+        std::cerr << "Unknown or unsupported simd kernel: "
+                  << options.simd_kernel << std::endl;
+        return false;
+    }
+    if (options.lloyd_center != "median" && options.lloyd_center != "mean")
+    {
+        std::cerr << "Unknown lloyd center: " << options.lloyd_center
+                  << std::endl;
+        return false;
+    }
+    if (options.limits.max_vertices < 3 || options.limits.max_triangles < 1)
+    {
+        std::cerr << "Invalid meshlet limits" << std::endl;
+        return false;
+    }
+    // the local vertices of an exported meshlet are addressed with 8 bits
+    if (options.export_limits.max_vertices < 3 ||
+        options.export_limits.max_vertices > 256 ||
+        options.export_limits.max_triangles < 1)
+    {
+        std::cerr << "Invalid export limits" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// runs the selected clustering algorithm on the given sites
+meshlets::ClusterAndSites run_clustering(pmp::SurfaceMesh &mesh,
+                                         std::vector<meshlets::Site> &sites,
+                                         const BakeOptions &options)
+{
+    meshlets::ClusterAndSites cluster_and_sites;
+    if (options.clustering == "bruteforce")
+    {
+        cluster_and_sites.cluster = meshlets::brute_force_sites(
+            mesh, sites, meshlets::NearestSiteSearch::Linear,
+            options.num_threads);
+        cluster_and_sites.sites = sites;
+    }
+    else if (options.clustering == "simd")
+    {
+        cluster_and_sites.cluster = meshlets::brute_force_sites(
+            mesh, sites, meshlets::NearestSiteSearch::Simd,
+            options.num_threads);
+        cluster_and_sites.sites = sites;
+    }
+    else if (options.clustering == "kdtree")
+    {
+        cluster_and_sites.cluster = meshlets::brute_force_sites(
+            mesh, sites, meshlets::NearestSiteSearch::KdTree,
+            options.num_threads);
+        cluster_and_sites.sites = sites;
+    }
+    else if (options.clustering == "parallel-grow")
+    {
+        cluster_and_sites.cluster = meshlets::grow_sites_parallel(
+            mesh, sites, options.max_iterations, options.num_threads);
+        cluster_and_sites.sites = sites;
+    }
+    else if (options.clustering == "priority-grow")
+    {
+        cluster_and_sites.cluster = meshlets::grow_sites_priority(
+            mesh, sites, options.max_iterations);
+        cluster_and_sites.sites = sites;
+    }
+    else if (options.clustering == "constrained")
+    {
+        cluster_and_sites =
+            meshlets::grow_sites_constrained(mesh, sites, options.limits);
+    }
+    else if (options.clustering == "lloyd")
+    {
+        cluster_and_sites =
+            meshlets::lloyd(mesh, sites, options.max_lloyd_iterations,
+                            options.lloyd_center == "mean"
+                                ? meshlets::LloydCenter::AreaWeightedMean
+                                : meshlets::LloydCenter::Median,
+                            options.lloyd_warm_start, options.num_threads);
+    }
+    else
+    {
+        cluster_and_sites.cluster =
+            meshlets::grow_sites(mesh, sites, options.max_iterations);
+        cluster_and_sites.sites = sites;
+    }
+    return cluster_and_sites;
+}
+
+// marks exactly the faces of the given sites in f:is_site (lloyd moves the sites)
+void reset_sites(pmp::SurfaceMesh &mesh, std::vector<meshlets::Site> &sites)
+{
+    auto is_site = mesh.get_face_property<bool>("f:is_site");
+    assert(is_site);
+    for (auto face : mesh.faces())
+    {
+        is_site[face] = false;
+    }
+    for (auto &site : sites)
+    {
+        is_site[site.face] = true;
+    }
+}
+
+// prints the mean time of options.benchmark_iterations clustering runs
+void benchmark_clustering(pmp::SurfaceMesh &mesh,
+                          std::vector<meshlets::Site> &sites,
+                          const BakeOptions &options)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < options.benchmark_iterations; i++)
+    {
+        reset_sites(mesh, sites);
+        run_clustering(mesh, sites, options);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed =
+        (end - start) / options.benchmark_iterations;
+    std::clog << "Mean Clustering over " << options.benchmark_iterations
+              << " iterations: " << elapsed.count() << " s" << std::endl;
+    reset_sites(mesh, sites);
+}
+
+// prints the number of meshlets and their mean and maximum size
+void print_meshlet_sizes(pmp::SurfaceMesh &mesh, meshlets::Cluster &cluster)
+{
+    size_t max_vertices = 0;
+    size_t max_triangles = 0;
+    size_t total_vertices = 0;
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        size_t num_vertices =
+            meshlets::get_vertices(mesh, cluster[meshlet_id]).size();
+        size_t num_triangles = cluster[meshlet_id].faces().size();
+        max_vertices = std::max(max_vertices, num_vertices);
+        max_triangles = std::max(max_triangles, num_triangles);
+        total_vertices += num_vertices;
+    }
+    auto valid = meshlets::validate_meshlets(mesh, cluster);
+    size_t num_valid = std::count(valid.begin(), valid.end(), true);
+    double num_meshlets = std::max<double>(cluster.size(), 1);
+    std::clog << "Meshlets: " << cluster.size() << " (" << num_valid
+              << " valid), vertices per meshlet: "
+              << total_vertices / num_meshlets << " (max " << max_vertices
+              << "), triangles per meshlet: "
+              << cluster.faces.size() / num_meshlets << " (max "
+              << max_triangles << ")" << std::endl;
+}
+
+// reports the mean time of checking every meshlet with is_valid and with validate_meshlets
+void benchmark_validation(pmp::SurfaceMesh &mesh, meshlets::Cluster &cluster,
+                          int iterations)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+        {
+            meshlets::is_valid(mesh, cluster[meshlet_id]);
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = (end - start) / iterations;
+    std::clog << "Mean Validation (per meshlet) over " << iterations
+              << " iterations: " << elapsed.count() << " s" << std::endl;
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        meshlets::validate_meshlets(mesh, cluster);
+    }
+    end = std::chrono::high_resolution_clock::now();
+    elapsed = (end - start) / iterations;
+    std::clog << "Mean Validation (single pass) over " << iterations
+              << " iterations: " << elapsed.count() << " s" << std::endl;
+}
+
+// reports the mean time of fixing the (valid) cluster after moving a growing number of faces to a meshlet
+// on the other side of the cluster, so the cost can be compared against the number of defects
+void benchmark_fixing(pmp::SurfaceMesh &mesh, meshlets::Cluster &cluster,
+                      int iterations)
+{
+    auto is_site = mesh.get_face_property<bool>("f:is_site");
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    auto valid_closest_site = closest_site.vector();
+    std::vector<pmp::Face> site_faces(cluster.size());
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        site_faces[meshlet_id] = meshlets::get_site_face(cluster[meshlet_id]);
+    }
+
+    for (size_t num_defects : {0, 10, 100, 1000, 10000})
+    {
+        if (num_defects > cluster.size())
+        {
+            break;
+        }
+        closest_site.vector() = valid_closest_site;
+        size_t step = cluster.faces.size() / std::max<size_t>(num_defects, 1);
+        for (size_t i = 0; i < num_defects; i++)
+        {
+            size_t position = i * step;
+            while (is_site[cluster.faces[position]])
+            {
+                position++;
+            }
+            auto face = cluster.faces[position];
+            closest_site[face] =
+                (closest_site[face] + cluster.size() / 2) % cluster.size();
+        }
+        auto defect_closest_site = closest_site.vector();
+        auto defect_cluster = meshlets::build_cluster(
+            mesh, site_faces, meshlets::FaceRange(cluster.faces));
+        auto valid = meshlets::validate_meshlets(mesh, defect_cluster);
+        size_t num_invalid = std::count(valid.begin(), valid.end(), false);
+
+        std::chrono::duration<double> elapsed(0);
+        for (int i = 0; i < iterations; i++)
+        {
+            closest_site.vector() = defect_closest_site;
+            auto fixed_cluster = defect_cluster;
+            auto start = std::chrono::high_resolution_clock::now();
+            meshlets::validate_and_fix_meshlets(mesh, fixed_cluster);
+            auto end = std::chrono::high_resolution_clock::now();
+            elapsed += end - start;
+        }
+        std::clog << "Mean Fixing of " << num_defects << " moved faces ("
+                  << num_invalid << " invalid meshlets) over " << iterations
+                  << " iterations: " << elapsed.count() / iterations << " s"
+                  << std::endl;
+    }
+    closest_site.vector() = valid_closest_site;
+}
+
+// prints the vertex reuse of exported meshlets
+void print_buffer_statistics(const meshlets::MeshletBuffers &buffers,
+                             const char *label)
+{
+    auto statistics = meshlets::analyze_meshlet_buffers(buffers);
+    std::clog << label << " meshlets: ACMR " << statistics.acmr
+              << ", vertices per triangle "
+              << statistics.vertices_per_triangle << std::endl;
+}
+
+// writes the meshlet id of every face, one per line
+bool write_meshlet_ids(pmp::SurfaceMesh &mesh, meshlets::Cluster &cluster,
+                       const std::string &file)
+{
+    std::vector<int> meshlet_ids(mesh.n_faces(), -1);
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        for (auto face : meshlets::get_faces(cluster[meshlet_id]))
+        {
+            meshlet_ids[face.idx()] = static_cast<int>(meshlet_id);
+        }
+    }
+
+    std::ofstream out(file);
+    if (!out)
+    {
+        return false;
+    }
+    for (auto meshlet_id : meshlet_ids)
+    {
+        out << meshlet_id << '\n';
+    }
+    return out.good();
+}
+} // namespace
+
+int main(int argc, char **argv)
+{
+    BakeOptions options;
+    try
+    {
+        if (!parse_options(argc, argv, options))
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Invalid option value: " << e.what() << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    pmp::SurfaceMesh mesh;
+    try
+    {
+        pmp::read(mesh, options.input);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to read " << options.input << ": " << e.what()
+                  << std::endl;
+        return 1;
+    }
+    if (!mesh.is_triangle_mesh())
+    {
+        std::cerr << options.input << " is not a triangle mesh" << std::endl;
+        return 1;
+    }
+
+    int num_sites = options.num_sites > 0
+                        ? options.num_sites
+                        : static_cast<int>(mesh.n_faces() * options.site_ratio);
+    if (num_sites < 1 || static_cast<size_t>(num_sites) > mesh.n_faces())
+    {
+        std::cerr << "Invalid number of sites: " << num_sites << std::endl;
+        return 1;
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<meshlets::Site> sites;
+    if (options.site_generator == "pds")
+    {
+        sites = meshlets::generate_pds_sites(mesh, num_sites);
+    }
+    else
+    {
+        sites = meshlets::generate_random_sites(mesh, num_sites);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    std::clog << "Generating Sites took: " << elapsed.count() << " s"
+              << std::endl;
+
+    if (options.benchmark_iterations > 0 && options.clustering == "simd")
+    {
+        // compare all kernels the CPU supports, the selected one is used for the output afterwards
+        for (auto kernel : {"scalar", "sse2", "avx2"})
+        {
+            if (meshlets::SitePositions::set_kernel(kernel))
+            {
+                std::clog << meshlets::SitePositions::kernel_name()
+                          << " kernel:" << std::endl;
+                benchmark_clustering(mesh, sites, options);
+            }
+        }
+        meshlets::SitePositions::set_kernel(options.simd_kernel);
+    }
+    else if (options.benchmark_iterations > 0)
+    {
+        benchmark_clustering(mesh, sites, options);
+    }
+
+    if (options.clustering == "simd")
+    {
+        std::clog << "Using the " << meshlets::SitePositions::kernel_name()
+                  << " kernel" << std::endl;
+    }
+
+    start = std::chrono::high_resolution_clock::now();
+    auto cluster_and_sites = run_clustering(mesh, sites, options);
+    auto &cluster = cluster_and_sites.cluster;
+    end = std::chrono::high_resolution_clock::now();
+    elapsed = end - start;
+    std::clog << "Clustering took: " << elapsed.count() << " s" << std::endl;
+
+    // fixing merges meshlets, which would break the size limits
+    if (options.fix_meshlets && options.clustering != "constrained")
+    {
+        start = std::chrono::high_resolution_clock::now();
+        meshlets::validate_and_fix_meshlets(mesh, cluster);
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::clog << "Validating and Fixing Meshlets took: " << elapsed.count()
+                  << " s" << std::endl;
+    }
+
+    print_meshlet_sizes(mesh, cluster);
+    if (options.benchmark_iterations > 0)
+    {
+        benchmark_validation(mesh, cluster, options.benchmark_iterations);
+        if (options.fix_meshlets && options.clustering != "constrained")
+        {
+            benchmark_fixing(mesh, cluster, options.benchmark_iterations);
+        }
+    }
+
+    if (!write_meshlet_ids(mesh, cluster, options.output))
+    {
+        std::cerr << "Failed to write " << options.output << std::endl;
+        return 1;
+    }
+    std::clog << "Wrote " << cluster.size() << " meshlets to "
+              << options.output << std::endl;
+
+    if (!options.export_file.empty())
+    {
+        start = std::chrono::high_resolution_clock::now();
+        meshlets::MeshletBuffers buffers;
+        meshlets::build_meshlet_buffers(mesh, cluster, buffers,
+                                        options.num_threads,
+                                        options.export_limits);
+        std::clog << "Exported " << buffers.meshlets.size() << " meshlets ("
+                  << buffers.meshlets.size() - cluster.size()
+                  << " added by splitting)" << std::endl;
+        print_buffer_statistics(buffers, "Exported");
+        if (options.optimize_export)
+        {
+            auto optimize_start = std::chrono::high_resolution_clock::now();
+            meshlets::optimize_meshlet_buffers(buffers);
+            auto optimize_end = std::chrono::high_resolution_clock::now();
+            std::chrono::duration<double> optimize_elapsed =
+                optimize_end - optimize_start;
+            std::clog << "Optimizing Meshlets took: "
+                      << optimize_elapsed.count() << " s" << std::endl;
+            print_buffer_statistics(buffers, "Optimized");
+        }
+        if (!meshlets::write_meshlet_buffers(buffers, options.export_file))
+        {
+            std::cerr << "Failed to write " << options.export_file
+                      << std::endl;
+            return 1;
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::clog << "Exporting Meshlets took: " << elapsed.count() << " s"
+                  << std::endl;
+    }
+
+    return 0;
+}
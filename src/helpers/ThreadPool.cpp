@@ -0,0 +1,141 @@
+#include "ThreadPool.h"
+
+namespace helpers {
+ThreadPool::ThreadPool(unsigned int num_threads)
+{
+    num_threads = resolve_num_threads(num_threads);
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+        workers.emplace_back([this]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true)
+            {
+                changed.wait(lock,
+                             [this]() { return stopping || !queue.empty(); });
+                if (stopping && queue.empty())
+                {
+                    return;
+                }
+                run_one(lock);
+            }
+        });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+bool ThreadPool::run_one(std::unique_lock<std::mutex> &lock)
+{
+    if (queue.empty())
+    {
+        return false;
+    }
+    auto task = std::move(queue.front());
+    queue.pop();
+    lock.unlock();
+    task();
+    lock.lock();
+    return true;
+}
+
+void ThreadPool::run(std::vector<std::function<void()>> &tasks)
+{
+    size_t remaining = tasks.size();
+    // the first exception thrown by a task
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &task : tasks)
+        {
+            // the wrapper never throws, so a worker does not terminate and this function does not return
+            // while queued wrappers still refer to its locals
+            queue.push([this, &task, &remaining, &error]() {
+                std::exception_ptr task_error;
+                try
+                {
+                    task();
+                }
+                catch (...)
+                {
+                    task_error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> lock(mutex);
+                if (task_error && !error)
+                {
+                    error = task_error;
+                }
+                remaining--;
+                changed.notify_all();
+            });
+        }
+    }
+    changed.notify_all();
+
+    // help with the queue instead of idling, this also makes nested use of the pool safe
+    std::unique_lock<std::mutex> lock(mutex);
+    while (remaining > 0)
+    {
+        if (!run_one(lock))
+        {
+            changed.wait(lock, [this, &remaining]() {
+                return remaining == 0 || !queue.empty();
+            });
+        }
+    }
+    lock.unlock();
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
+
+unsigned int resolve_num_threads(unsigned int num_threads)
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::thread::hardware_concurrency();
+    }
+    return num_threads > 0 ? num_threads : 1;
+}
+
+void parallel_for(size_t size, unsigned int num_chunks,
+                  const std::function<void(unsigned int chunk, size_t begin,
+                                           size_t end)> &function)
+{
+    num_chunks = num_chunks > 0 ? num_chunks : 1;
+    if (num_chunks == 1)
+    {
+        function(0, 0, size);
+        return;
+    }
+
+    std::vector<std::function<void()>> tasks;
+    tasks.reserve(num_chunks);
+    for (unsigned int chunk = 0; chunk < num_chunks; chunk++)
+    {
+        size_t begin = size * chunk / num_chunks;
+        size_t end = size * (chunk + 1) / num_chunks;
+        tasks.push_back([&function, chunk, begin, end]() {
+            function(chunk, begin, end);
+        });
+    }
+    ThreadPool::shared().run(tasks);
+}
+} // namespace helpers
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace helpers {
+/**
+ * @brief A fixed set of worker threads that execute tasks from a shared queue.
+ * A thread waiting for its tasks executes queued tasks itself, so tasks may use the pool again (nested parallelism does not deadlock).
+*/
+class ThreadPool
+{
+public:
+    /**
+     * @brief creates the pool
+     * 
+     * @param num_threads number of worker threads (0: one per hardware thread)
+    */
+    explicit ThreadPool(unsigned int num_threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief the pool shared by all algorithms (one worker per hardware thread)
+    */
+    static ThreadPool &shared();
+
+    // number of worker threads
+    unsigned int size() const { return workers.size(); }
+
+    /**
+     * @brief runs all tasks and blocks until they are finished
+     * If tasks throw, the other tasks still run and the first exception is rethrown once all tasks are finished.
+     * 
+     * @param tasks the tasks to run
+    */
+    void run(std::vector<std::function<void()>> &tasks);
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> queue;
+    std::mutex mutex;
+    // signaled when tasks are queued or finished
+    std::condition_variable changed;
+    bool stopping = false;
+
+    // pops and executes one task, returns false if the queue is empty
+    bool run_one(std::unique_lock<std::mutex> &lock);
+};
+
+/**
+ * @brief resolves a requested number of threads (0: one per hardware thread)
+ * 
+ * @param num_threads the requested number of threads
+*/
+unsigned int resolve_num_threads(unsigned int num_threads);
+
+/**
+ * @brief splits [0, size) into num_chunks contiguous chunks and calls function(chunk, begin, end) for each chunk on the shared thread pool.
+ * The chunk boundaries only depend on size and num_chunks, so results written per chunk are deterministic.
+ * With a single chunk the function is called directly on the calling thread.
+ * 
+ * @param size the size of the range
+ * @param num_chunks the number of chunks (usually the number of threads)
+ * @param function the function to call for each chunk
+*/
+void parallel_for(size_t size, unsigned int num_chunks,
+                  const std::function<void(unsigned int chunk, size_t begin,
+                                           size_t end)> &function);
+} // namespace helpers
@@ -0,0 +1,72 @@
+#include "GeometryCache.h"
+#include "pmp/algorithms/differential_geometry.h"
+#include "pmp/algorithms/normals.h"
+
+namespace meshlets {
+namespace {
+// names of the face properties holding the cache
+const char *cache_properties[] = {"f:centroid_x", "f:centroid_y",
+                                  "f:centroid_z", "f:normal_x",
+                                  "f:normal_y",   "f:normal_z",
+                                  "f:area"};
+} // namespace
+
+GeometryCache get_geometry_cache(pmp::SurfaceMesh &mesh)
+{
+    // faces added after the cache was computed get the default area -1, faces are always appended,
+    // so a cache that misses faces has a negative area on the last face
+    auto cached_area = mesh.get_face_property<float>("f:area");
+    if (cached_area && mesh.faces_size() > 0 &&
+        cached_area.vector().back() < 0.0f)
+    {
+        invalidate_geometry_cache(mesh);
+    }
+
+    if (!mesh.has_face_property("f:area"))
+    {
+        auto centroid_x = mesh.add_face_property<float>("f:centroid_x");
+        auto centroid_y = mesh.add_face_property<float>("f:centroid_y");
+        auto centroid_z = mesh.add_face_property<float>("f:centroid_z");
+        auto normal_x = mesh.add_face_property<float>("f:normal_x");
+        auto normal_y = mesh.add_face_property<float>("f:normal_y");
+        auto normal_z = mesh.add_face_property<float>("f:normal_z");
+        auto area = mesh.add_face_property<float>("f:area", -1.0f);
+
+        for (auto face : mesh.faces())
+        {
+            auto centroid = pmp::centroid(mesh, face);
+            centroid_x[face] = centroid[0];
+            centroid_y[face] = centroid[1];
+            centroid_z[face] = centroid[2];
+            auto normal = pmp::face_normal(mesh, face);
+            normal.normalize();
+            normal_x[face] = normal[0];
+            normal_y[face] = normal[1];
+            normal_z[face] = normal[2];
+            area[face] = pmp::face_area(mesh, face);
+        }
+    }
+
+    GeometryCache cache;
+    cache.centroid_x = mesh.get_face_property<float>("f:centroid_x").data();
+    cache.centroid_y = mesh.get_face_property<float>("f:centroid_y").data();
+    cache.centroid_z = mesh.get_face_property<float>("f:centroid_z").data();
+    cache.normal_x = mesh.get_face_property<float>("f:normal_x").data();
+    cache.normal_y = mesh.get_face_property<float>("f:normal_y").data();
+    cache.normal_z = mesh.get_face_property<float>("f:normal_z").data();
+    cache.area = mesh.get_face_property<float>("f:area").data();
+    return cache;
+}
+
+void invalidate_geometry_cache(pmp::SurfaceMesh &mesh)
+{
+    for (auto name : cache_properties)
+    {
+        auto property = mesh.get_face_property<float>(name);
+        if (property)
+        {
+            mesh.remove_face_property(property);
+        }
+    }
+}
+} // namespace meshlets
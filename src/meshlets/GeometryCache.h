@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pmp/surface_mesh.h"
+
+namespace meshlets {
+/**
+ * @brief The GeometryCache data structure gives access to the centroid, normal and area of every face.
+ * The values are stored as separate float face properties (structure of arrays) and computed only once per mesh.
+ * Adding faces is detected and the cache is computed again on the next get_geometry_cache.
+ * Moving vertices is not detected, callers must call invalidate_geometry_cache after changing the positions.
+*/
+typedef struct GeometryCache
+{
+    const float *centroid_x;
+    const float *centroid_y;
+    const float *centroid_z;
+    // unit face normals
+    const float *normal_x;
+    const float *normal_y;
+    const float *normal_z;
+    const float *area;
+
+    pmp::Point centroid(pmp::Face face) const
+    {
+        auto idx = face.idx();
+        return pmp::Point(centroid_x[idx], centroid_y[idx], centroid_z[idx]);
+    }
+
+    pmp::Normal normal(pmp::Face face) const
+    {
+        auto idx = face.idx();
+        return pmp::Normal(normal_x[idx], normal_y[idx], normal_z[idx]);
+    }
+} GeometryCache;
+
+/**
+ * @brief returns the geometry cache of the mesh, computes it if the mesh has none yet or faces were added since
+ * 
+ * @param mesh the mesh to get the cache for
+*/
+GeometryCache get_geometry_cache(pmp::SurfaceMesh &mesh);
+
+/**
+ * @brief removes the geometry cache from the mesh, must be called after vertices of the mesh were moved
+ * 
+ * @param mesh the mesh to remove the cache from
+*/
+void invalidate_geometry_cache(pmp::SurfaceMesh &mesh);
+} // namespace meshlets
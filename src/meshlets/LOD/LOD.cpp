@@ -1,242 +1,616 @@
 #include "LOD.h"
+#include "../GeometryCache.h"
 #include "../sites/RandomSites.h"
+#include "../clustering/KdTree.h"
 #include "../clustering/Lloyd.h"
 #include "../../helpers/Random.h"
+#include "../../helpers/ThreadPool.h"
+#include "pmp/algorithms/decimation.h"
+#include "pmp/algorithms/distance_point_triangle.h"
 
-#include <map>
+#include <atomic>
+#include <limits>
+#include <numeric>
 
 namespace meshlets {
-std::vector<TreeNode> get_nodes(TreeNode &root, int level)
+void LodTree::clear()
 {
-    std::vector<TreeNode> nodes;
-    if (root.level == level)
+    parent.clear();
+    first_child.clear();
+    child_count.clear();
+    level.clear();
+    color.clear();
+    error.clear();
+    bounds.clear();
+    lod_center.clear();
+    lod_radius.clear();
+    node_faces.clear();
+    face_offsets = {0};
+    level_offsets = {0};
+    meshes.clear();
+}
+
+std::vector<int> get_nodes(const LodTree &tree, int level)
+{
+    std::vector<int> nodes;
+    if (level >= 0 && level < tree.n_levels())
     {
-        nodes.push_back(root);
+        nodes.resize(tree.level_offsets[level + 1] - tree.level_offsets[level]);
+        std::iota(nodes.begin(), nodes.end(), tree.level_offsets[level]);
     }
-    else
+    return nodes;
+}
+
+namespace {
+// grows a sphere until it contains another sphere
+void merge_spheres(pmp::Point &center, float &radius,
+                   const pmp::Point &other_center, float other_radius)
+{
+    float distance = pmp::distance(center, other_center);
+    if (distance + other_radius <= radius)
     {
-        for (auto child : *root.children)
-        {
-            std::vector<TreeNode> child_nodes = get_nodes(child, level);
-            nodes.insert(nodes.end(), child_nodes.begin(), child_nodes.end());
-        }
+        return;
     }
-    return nodes;
+    if (distance + radius <= other_radius)
+    {
+        center = other_center;
+        radius = other_radius;
+        return;
+    }
+    float new_radius = (radius + distance + other_radius) * 0.5f;
+    center += (other_center - center) * ((new_radius - radius) / distance);
+    radius = new_radius;
 }
 
-int generate_node_id(std::unordered_map<int, bool> &generated_ids)
+// faces of the nodes of one level in node order, the faces of the i-th node of the level are faces[offsets[i], offsets[i + 1])
+typedef struct LevelFaces
 {
-    int id = helpers::generate_random_id();
-    while (generated_ids.find(id) != generated_ids.end())
+    std::vector<pmp::Face> faces;
+    std::vector<pmp::IndexType> offsets = {0};
+
+    // faces of the nodes [first, last) of the level (indices in the level)
+    FaceRange range(int first, int last) const
     {
-        id = helpers::generate_random_id();
+        return FaceRange(faces.data() + offsets[first],
+                         faces.data() + offsets[last]);
     }
-    generated_ids[id] = true;
-    return id;
+} LevelFaces;
+
+// appends a node without children (its faces are set by the simplification), returns its index
+int add_node(LodTree &tree, int parent, int level)
+{
+    tree.parent.push_back(parent);
+    tree.first_child.push_back(-1);
+    tree.child_count.push_back(0);
+    tree.level.push_back(level);
+    tree.color.push_back(helpers::generate_random_color());
+    tree.error.push_back(0.0f);
+    return static_cast<int>(tree.size()) - 1;
 }
 
-TreeNode build_lod_tree(pmp::SurfaceMesh &mesh, int num_levels,
-                        int num_level1_sites)
+// largest distance of the vertices of the fine faces to the closest coarse face, the closest face
+// is searched among the face with the closest centroid and its neighbors
+float simplification_error(const pmp::SurfaceMesh &fine_mesh,
+                           FaceRange fine_faces,
+                           const pmp::SurfaceMesh &coarse_mesh,
+                           FaceRange coarse_faces)
 {
-    std::unordered_map<int, bool> generated_ids;
-    // root has no parent
-    TreeNode root = TreeNode({generate_node_id(generated_ids),
-                              helpers::generate_random_color(),
-                              std::make_shared<TreeNode>(),
-                              std::make_shared<std::vector<TreeNode>>(),
-                              std::make_shared<std::vector<pmp::Face>>(
-                                  mesh.faces_begin(), mesh.faces_end()),
-                              0});
+    if (coarse_faces.empty())
+    {
+        return 0.0f;
+    }
+    auto triangle_distance = [&](const pmp::Point &point, pmp::Face face) {
+        auto h = coarse_mesh.halfedge(face);
+        pmp::Point nearest;
+        return pmp::dist_point_triangle(
+            point, coarse_mesh.position(coarse_mesh.from_vertex(h)),
+            coarse_mesh.position(coarse_mesh.to_vertex(h)),
+            coarse_mesh.position(
+                coarse_mesh.to_vertex(coarse_mesh.next_halfedge(h))),
+            nearest);
+    };
 
-    int lloyd_max_iter = 20;
-    int min_faces_per_meshlet = 10;
-    float num_new_sites = 3;
-    std::vector<TreeNode> last_added_nodes = {root};
+    std::vector<Site> centroids;
+    centroids.reserve(coarse_faces.size());
+    for (auto face : coarse_faces)
+    {
+        pmp::Point centroid(0, 0, 0);
+        for (auto v : coarse_mesh.vertices(face))
+        {
+            centroid += coarse_mesh.position(v);
+        }
+        centroids.emplace_back(static_cast<int>(centroids.size()), face,
+                               centroid / 3.0f, pmp::Normal(0, 0, 0));
+    }
+    KdTree tree(centroids);
 
-    for (int i = 1; i < num_levels; i++)
+    float error = 0.0f;
+    for (auto face : fine_faces)
     {
-        std::vector<TreeNode> new_added_nodes;
-        for (auto &parent_node : last_added_nodes)
+        for (auto v : fine_mesh.vertices(face))
         {
-            std::vector<pmp::Face> faces = *parent_node.faces;
-            // nodes become to small, stop and return an empty tree
-            if (faces.size() < min_faces_per_meshlet)
+            auto &point = fine_mesh.position(v);
+            float centroid_distance;
+            auto closest =
+                centroids[tree.closest_site(point, centroid_distance)].face;
+            float distance = triangle_distance(point, closest);
+            for (auto adjacent_face : get_adjacent_faces(coarse_mesh, closest))
             {
-                TreeNode root =
-                    TreeNode({generate_node_id(generated_ids),
-                              helpers::generate_random_color(),
-                              std::make_shared<TreeNode>(),
-                              std::make_shared<std::vector<TreeNode>>(),
-                              std::make_shared<std::vector<pmp::Face>>(
-                                  mesh.faces_begin(), mesh.faces_end()),
-                              0});
-                return root;
+                distance =
+                    std::min(distance, triangle_distance(point, adjacent_face));
             }
+            error = std::max(error, distance);
+        }
+    }
+    return error;
+}
+
+// sets the faces of the nodes to a simplified copy of the faces of their children, from the finest level up,
+// and computes the bounds of all nodes (finest_faces holds the faces of the finest level on the input mesh)
+void simplify_lod_tree(pmp::SurfaceMesh &mesh, LodTree &tree,
+                       LevelFaces finest_faces)
+{
+    int num_levels = tree.n_levels();
+    tree.meshes.resize(num_levels);
+    std::vector<LevelFaces> level_faces(num_levels);
 
-            std::vector<Site> sites;
-            if (i == 1)
+    // the finest level keeps the faces of the mesh (the copy keeps the indices)
+    tree.meshes[num_levels - 1].assign(mesh);
+    // every vertex remembers the vertex of the input mesh it stems from, the borders between the nodes are locked,
+    // so the vertices of neighboring nodes of different levels can be matched (see extract_nodes)
+    auto finest_source =
+        tree.meshes[num_levels - 1].add_vertex_property<int>("v:source");
+    for (auto v : tree.meshes[num_levels - 1].vertices())
+    {
+        finest_source[v] = v.idx();
+    }
+    level_faces[num_levels - 1] = std::move(finest_faces);
+
+    for (int level = num_levels - 2; level >= 0; level--)
+    {
+        auto &fine_mesh = tree.meshes[level + 1];
+        auto &coarse_mesh = tree.meshes[level];
+        coarse_mesh.assign(fine_mesh);
+        // assign only copies the standard properties, the indices of the copy are the same
+        auto source = coarse_mesh.add_vertex_property<int>("v:source");
+        source.vector() = fine_mesh.get_vertex_property<int>("v:source").vector();
+        int level_begin = tree.level_offsets[level];
+        int level_end = tree.level_offsets[level + 1];
+        int num_nodes = level_end - level_begin;
+        auto &fine_faces = level_faces[level + 1];
+        auto &coarse_faces = level_faces[level];
+
+        // the children of a node are stored next to each other, so their faces are a single range of the finer level
+        auto children_faces = [&](int node) {
+            int first_child = tree.first_child[node] - level_end;
+            return fine_faces.range(first_child,
+                                    first_child + tree.child_count[node]);
+        };
+
+        // node (index in the level) the faces of the finer level are merged into
+        auto lod_node = coarse_mesh.add_face_property<int>("f:lod_node", -1);
+        for (int node = level_begin; node < level_end; node++)
+        {
+            for (auto face : children_faces(node))
             {
-                sites = generate_random_sites(mesh, num_level1_sites, faces);
+                lod_node[face] = node - level_begin;
             }
-            else
+        }
+
+        // only vertices inside of a node may be removed, so the borders between the nodes stay the same
+        // and the nodes fit to their neighbors on all levels
+        auto selected =
+            coarse_mesh.add_vertex_property<bool>("v:selected", false);
+        size_t num_selected = 0;
+        for (auto v : coarse_mesh.vertices())
+        {
+            auto faces = coarse_mesh.faces(v);
+            int node = faces.begin() != faces.end() ? lod_node[*faces.begin()]
+                                                    : -1;
+            bool inside = node != -1;
+            for (auto face : faces)
             {
-                sites = generate_random_sites(mesh, num_new_sites, faces);
+                inside = inside && lod_node[face] == node;
             }
+            selected[v] = inside;
+            num_selected += selected[v];
+        }
+        // each collapse removes one vertex and two faces, so removing a quarter of the faces in vertices halves the faces
+        // (the decimation treats all vertices as selected if none is)
+        if (num_selected > 0)
+        {
+            auto target = coarse_mesh.n_vertices() -
+                          std::min<size_t>(coarse_mesh.n_faces() / 4,
+                                           num_selected);
+            pmp::decimate(coarse_mesh, static_cast<unsigned int>(target));
+        }
+        coarse_mesh.remove_vertex_property(selected);
+        invalidate_geometry_cache(coarse_mesh);
 
-            ClusterAndSites level_i = lloyd(mesh, sites, faces, lloyd_max_iter);
-            validate_and_fix_meshlets(mesh, level_i.cluster, faces);
+        // sort the remaining faces by node (counting sort)
+        coarse_faces.offsets.assign(num_nodes + 1, 0);
+        for (auto face : coarse_mesh.faces())
+        {
+            if (lod_node[face] != -1)
+            {
+                coarse_faces.offsets[lod_node[face] + 1]++;
+            }
+        }
+        for (int i = 0; i < num_nodes; i++)
+        {
+            coarse_faces.offsets[i + 1] += coarse_faces.offsets[i];
+        }
+        coarse_faces.faces.resize(coarse_faces.offsets[num_nodes]);
+        std::vector<pmp::IndexType> next_slot(coarse_faces.offsets.begin(),
+                                              coarse_faces.offsets.end() - 1);
+        for (auto face : coarse_mesh.faces())
+        {
+            if (lod_node[face] != -1)
+            {
+                coarse_faces.faces[next_slot[lod_node[face]]++] = face;
+            }
+        }
+        coarse_mesh.remove_face_property(lod_node);
 
-            for (auto meshlet : level_i.cluster)
+        for (int node = level_begin; node < level_end; node++)
+        {
+            float children_error = 0.0f;
+            int first_child = tree.first_child[node];
+            for (int child = first_child;
+                 child < first_child + tree.child_count[node]; child++)
             {
-                auto faces = get_faces(*meshlet);
-                if (faces.size() == 0)
-                    continue;
-
-                TreeNode child_node = TreeNode(
-                    {generate_node_id(generated_ids),
-                     helpers::generate_random_color(),
-                     std::make_shared<TreeNode>(parent_node),
-                     std::make_shared<std::vector<TreeNode>>(),
-                     std::make_shared<std::vector<pmp::Face>>(faces), i});
-                parent_node.children->push_back(child_node);
-                new_added_nodes.push_back(child_node);
+                children_error = std::max(children_error, tree.error[child]);
             }
+            // the error of a node is never smaller than that of its children, so coarser nodes are never chosen for more detail
+            int i = node - level_begin;
+            tree.error[node] = std::max(
+                children_error,
+                simplification_error(fine_mesh, children_faces(node),
+                                     coarse_mesh, coarse_faces.range(i, i + 1)));
         }
-        last_added_nodes = new_added_nodes;
     }
 
-    return root;
-}
+    // the levels are stored one after another, like the nodes
+    tree.node_faces.clear();
+    tree.face_offsets = {0};
+    for (auto &faces : level_faces)
+    {
+        auto level_offset = tree.node_faces.size();
+        tree.node_faces.insert(tree.node_faces.end(), faces.faces.begin(),
+                               faces.faces.end());
+        for (size_t i = 1; i < faces.offsets.size(); i++)
+        {
+            tree.face_offsets.push_back(level_offset + faces.offsets[i]);
+        }
+        // the faces of the level are not needed anymore
+        faces = LevelFaces();
+    }
 
-void color_level(pmp::SurfaceMesh &mesh, TreeNode &root, int level)
-{
-    // create color face property
-    pmp::FaceProperty<pmp::Color> color;
-    if (!mesh.has_face_property("f:color"))
+    tree.bounds.resize(tree.size());
+    for (size_t node = 0; node < tree.size(); node++)
     {
-        color =
-            mesh.add_face_property<pmp::Color>("f:color", pmp::Color(0, 0, 0));
+        tree.bounds[node] =
+            compute_bounds(tree.meshes[tree.level[node]], tree.faces(node));
     }
-    else
+
+    // the children are stored after their parent, so the lod spheres are merged from the last node up
+    tree.lod_center.resize(tree.size());
+    tree.lod_radius.resize(tree.size());
+    for (int node = static_cast<int>(tree.size()) - 1; node >= 0; node--)
     {
-        color = mesh.get_face_property<pmp::Color>("f:color");
-        for (auto face : mesh.faces())
+        auto &center = tree.lod_center[node];
+        auto &radius = tree.lod_radius[node];
+        int first_child = tree.first_child[node];
+        bool has_faces = !tree.faces(node).empty();
+        if (has_faces || tree.child_count[node] == 0)
+        {
+            center = tree.bounds[node].center;
+            radius = tree.bounds[node].radius;
+        }
+        else
         {
-            color[face] = pmp::Color(0, 0, 0);
+            center = tree.lod_center[first_child];
+            radius = tree.lod_radius[first_child];
+        }
+        for (int child = first_child;
+             child < first_child + tree.child_count[node]; child++)
+        {
+            merge_spheres(center, radius, tree.lod_center[child],
+                          tree.lod_radius[child]);
         }
     }
+}
 
-    auto nodes = get_nodes(root, level);
-    for (auto node : nodes)
+// copies the faces into an own mesh, face i of the result is faces[i]
+void copy_faces(const pmp::SurfaceMesh &mesh, FaceRange faces,
+                pmp::SurfaceMesh &result)
+{
+    std::unordered_map<int, pmp::Vertex> new_vertices;
+    std::vector<pmp::Vertex> face_vertices;
+    for (auto face : faces)
     {
-        auto node_color = helpers::generate_random_color();
-
-        for (auto face : *node.faces)
+        face_vertices.clear();
+        for (auto v : mesh.vertices(face))
         {
-            color[face] = node_color;
+            auto new_vertex = new_vertices.find(v.idx());
+            if (new_vertex == new_vertices.end())
+            {
+                new_vertex =
+                    new_vertices
+                        .emplace(v.idx(), result.add_vertex(mesh.position(v)))
+                        .first;
+            }
+            face_vertices.push_back(new_vertex->second);
+        }
+        try
+        {
+            result.add_face(face_vertices);
+        }
+        catch (const pmp::TopologyException &)
+        {
+            // a face that cannot be linked to the others (non-manifold input) gets its own vertices
+            for (auto &v : face_vertices)
+            {
+                pmp::Point position = result.position(v);
+                v = result.add_vertex(position);
+            }
+            result.add_face(face_vertices);
         }
     }
 }
 
-void color_lod(pmp::SurfaceMesh &mesh, TreeNode &root,
-               pmp::vec3 &camera_position,
-               std::vector<meshlets::TreeNode> &currently_visible_nodes)
+// splits the faces of a node into meshlets and returns the faces of the non-empty ones
+std::vector<std::vector<pmp::Face>> split_node(
+    pmp::SurfaceMesh &mesh, FaceRange faces, int num_sites, int lloyd_max_iter,
+    unsigned int num_threads)
 {
-    // create color face property
-    pmp::FaceProperty<pmp::Color> color;
-    if (!mesh.has_face_property("f:color"))
+    // the clustering resets its properties on the whole mesh, so nodes that are split at the same time
+    // work on a copy of their faces (the root covers the whole mesh and uses it directly)
+    bool whole_mesh = faces.size() == mesh.n_faces();
+    pmp::SurfaceMesh node_mesh_copy;
+    std::vector<pmp::Face> node_faces(faces.begin(), faces.end());
+    if (!whole_mesh)
     {
-        color =
-            mesh.add_face_property<pmp::Color>("f:color", pmp::Color(0, 0, 0));
+        copy_faces(mesh, faces, node_mesh_copy);
+        node_faces.assign(node_mesh_copy.faces_begin(),
+                          node_mesh_copy.faces_end());
     }
-    else
+    auto &node_mesh = whole_mesh ? mesh : node_mesh_copy;
+
+    auto sites = generate_random_sites(node_mesh, num_sites, node_faces);
+    ClusterAndSites clustering =
+        lloyd(node_mesh, sites, node_faces, lloyd_max_iter,
+              LloydCenter::Median, false, num_threads);
+    validate_and_fix_meshlets(node_mesh, clustering.cluster, node_faces);
+
+    std::vector<std::vector<pmp::Face>> meshlet_faces;
+    for (size_t meshlet_id = 0; meshlet_id < clustering.cluster.size();
+         meshlet_id++)
     {
-        color = mesh.get_face_property<pmp::Color>("f:color");
-    }
+        auto meshlet = get_faces(clustering.cluster[meshlet_id]);
+        if (meshlet.size() == 0)
+            continue;
 
-    auto distance_to_mesh_center =
-        pmp::distance(camera_position, pmp::centroid(mesh));
+        meshlet_faces.emplace_back();
+        for (auto face : meshlet)
+        {
+            meshlet_faces.back().push_back(whole_mesh ? face
+                                                      : faces[face.idx()]);
+        }
+    }
+    return meshlet_faces;
+}
+} // namespace
 
-    auto mesh_bounds = pmp::bounds(mesh).size();
+LodTree build_lod_tree(pmp::SurfaceMesh &mesh, int num_levels,
+                       int num_level1_sites, unsigned int num_threads)
+{
+    num_threads = helpers::resolve_num_threads(num_threads);
 
-    std::vector<TreeNode> nodes_to_add;
-    std::vector<TreeNode> nodes_to_remove;
+    LodTree tree;
+    // root has no parent
+    add_node(tree, -1, 0);
+    tree.level_offsets.push_back(tree.size());
+    // faces of the nodes of the last added level, the faces of a level are not needed anymore once it is split
+    LevelFaces level_faces;
+    level_faces.faces.assign(mesh.faces_begin(), mesh.faces_end());
+    level_faces.offsets.push_back(level_faces.faces.size());
 
-    std::unordered_map<int, bool> invalid_nodes;
+    int lloyd_max_iter = 20;
+    size_t min_faces_per_meshlet = 10;
+    float num_new_sites = 3;
 
-    for (auto node : currently_visible_nodes)
+    for (int i = 1; i < num_levels; i++)
     {
-        // if node is invalid, skip it
-        if (invalid_nodes.find(node.id) != invalid_nodes.end())
-            continue;
+        int parents_begin = tree.level_offsets[i - 1];
+        int num_parents = tree.level_offsets[i] - parents_begin;
 
-        auto distance_to_camera = pmp::distance(
-            camera_position, pmp::centroid(mesh, node.faces->at(0)));
+        // nodes become to small, stop and return a tree of only the root
+        bool too_small = false;
+        for (int parent = 0; parent < num_parents; parent++)
+        {
+            too_small = too_small ||
+                        level_faces.range(parent, parent + 1).size() <
+                            min_faces_per_meshlet;
+        }
+        if (too_small)
+        {
+            tree.clear();
+            add_node(tree, -1, 0);
+            tree.level_offsets.push_back(tree.size());
+            level_faces.faces.assign(mesh.faces_begin(), mesh.faces_end());
+            level_faces.offsets = {0, static_cast<pmp::IndexType>(
+                                          level_faces.faces.size())};
+            break;
+        }
 
-        auto angle_to_camera =
-            pmp::dot(pmp::normalize(pmp::face_normal(mesh, node.faces->at(0))),
-                     pmp::normalize(camera_position -
-                                    pmp::centroid(mesh, node.faces->at(0))));
+        // the parents have disjoint faces and are split independently, each thread takes the next parent
+        // that is left (the sizes of the parents differ)
+        std::vector<std::vector<std::vector<pmp::Face>>> children_faces(
+            num_parents);
+        int num_sites = i == 1 ? num_level1_sites : num_new_sites;
+        // a single parent (the root) is split with all threads instead
+        unsigned int num_parent_threads = num_parents == 1 ? num_threads : 1;
+        std::atomic<int> next_parent(0);
+        helpers::parallel_for(
+            num_threads, num_threads / num_parent_threads,
+            [&](unsigned int, size_t, size_t) {
+                for (int parent = next_parent++; parent < num_parents;
+                     parent = next_parent++)
+                {
+                    children_faces[parent] = split_node(
+                        mesh, level_faces.range(parent, parent + 1),
+                        num_sites, lloyd_max_iter, num_parent_threads);
+                }
+            });
 
-        if ((angle_to_camera < -0.25 &&
-             distance_to_camera > distance_to_mesh_center) ||
-            distance_to_camera > 2 * mesh_bounds)
+        level_faces = LevelFaces();
+        for (int parent = 0; parent < num_parents; parent++)
         {
-            // this is the coarsest level since its parent is the root (i.e. the whole mesh)
-            if (node.level == 1)
-                continue;
-            // go up one level
-            auto parent = node.parent;
-
-            // invalidate all nodes that are not visible anymore
-            for (auto child : *parent->children)
+            int parent_node = parents_begin + parent;
+            tree.first_child[parent_node] = tree.size();
+            tree.child_count[parent_node] = children_faces[parent].size();
+            for (auto &faces : children_faces[parent])
             {
-                invalid_nodes[child.id] = true;
-                nodes_to_remove.push_back(child);
+                add_node(tree, parent_node, i);
+                level_faces.faces.insert(level_faces.faces.end(),
+                                         faces.begin(), faces.end());
+                level_faces.offsets.push_back(level_faces.faces.size());
             }
-
-            // add the parent node
-            nodes_to_add.push_back(*parent);
+            // the faces are copied, free them early
+            children_faces[parent] = std::vector<std::vector<pmp::Face>>();
         }
-        else if (angle_to_camera > 0.25 &&
-                 distance_to_camera < distance_to_mesh_center)
-        {
-            auto children = node.children;
-            // this is the finest level since it has no children
-            if (children->size() == 0)
-                continue;
+        tree.level_offsets.push_back(tree.size());
+    }
 
-            // invalidate the parent node
-            invalid_nodes[node.id] = true;
-            nodes_to_remove.push_back(node);
+    simplify_lod_tree(mesh, tree, std::move(level_faces));
+    return tree;
+}
 
-            // add the children nodes
-            nodes_to_add.insert(nodes_to_add.end(), children->begin(),
-                                children->end());
+void extract_nodes(const LodTree &tree, const std::vector<int> &nodes,
+                   pmp::SurfaceMesh &result)
+{
+    result.clear();
+    auto color = result.add_face_property<pmp::Color>("f:color");
+
+    if (nodes.empty())
+    {
+        return;
+    }
+
+    // vertices of the new mesh by vertex of the input mesh (v:source), so neighboring nodes share their border vertices
+    // even if they are of different levels
+    std::vector<pmp::Vertex> new_vertices(tree.meshes.back().vertices_size());
+    std::vector<pmp::Vertex> face_vertices;
+    for (auto node : nodes)
+    {
+        auto &node_mesh = tree.mesh(node);
+        auto source = node_mesh.get_vertex_property<int>("v:source");
+        for (auto face : tree.faces(node))
+        {
+            face_vertices.clear();
+            for (auto v : node_mesh.vertices(face))
+            {
+                auto &new_vertex = new_vertices[source[v]];
+                if (!new_vertex.is_valid())
+                {
+                    new_vertex = result.add_vertex(node_mesh.position(v));
+                }
+                face_vertices.push_back(new_vertex);
+            }
+            color[result.add_face(face_vertices)] = tree.color[node];
         }
     }
+}
+
+void color_level(pmp::SurfaceMesh &mesh, const LodTree &tree, int level)
+{
+    extract_nodes(tree, get_nodes(tree, level), mesh);
+}
 
-    // update currently visible nodes
-    for (auto node : nodes_to_remove)
+namespace {
+// error of a node in pixels, projected from the closest point of its lod sphere (the camera inside of the sphere sees any error)
+float projected_error(const LodTree &tree, int node,
+                      const pmp::Point &camera_position,
+                      float projection_scale)
+{
+    float distance = pmp::distance(camera_position, tree.lod_center[node]) -
+                     tree.lod_radius[node];
+    if (distance <= 0.0f)
     {
-        currently_visible_nodes.erase(
-            std::remove(currently_visible_nodes.begin(),
-                        currently_visible_nodes.end(), node),
-            currently_visible_nodes.end());
+        return std::numeric_limits<float>::max();
     }
+    return tree.error[node] * projection_scale / distance;
+}
 
-    for (auto node : nodes_to_add)
+// selects the node or descends to its children, was_refined tells if the node was refined in the last selection
+void select_lod_nodes(const LodTree &tree, int node, bool was_refined,
+                      const pmp::Point &camera_position,
+                      float projection_scale, float max_pixel_error,
+                      float hysteresis, LodSelection &selection)
+{
+    bool refine = false;
+    if (tree.child_count[node] > 0)
     {
-        currently_visible_nodes.push_back(node);
+        float threshold =
+            was_refined ? max_pixel_error * (1.0f - hysteresis)
+                        : max_pixel_error;
+        refine = projected_error(tree, node, camera_position,
+                                 projection_scale) > threshold;
+    }
+    selection.refined[node] = refine;
+    if (!refine)
+    {
+        selection.nodes.push_back(node);
+        return;
     }
 
-    // color all nodes
-    for (auto node : currently_visible_nodes)
+    int first_child = tree.first_child[node];
+    for (int child = first_child; child < first_child + tree.child_count[node];
+         child++)
     {
-        for (auto face : *node.faces)
-        {
-            color[face] = node.color;
-        }
+        // the state of a child is outdated if the node was not refined before
+        select_lod_nodes(tree, child, was_refined && selection.refined[child],
+                         camera_position, projection_scale, max_pixel_error,
+                         hysteresis, selection);
+    }
+}
+} // namespace
+
+void select_lod_nodes(const LodTree &tree, const pmp::Point &camera_position,
+                      float projection_scale, float max_pixel_error,
+                      LodSelection &selection, float hysteresis)
+{
+    selection.nodes.clear();
+    if (tree.empty())
+    {
+        return;
     }
+    // the state is kept between selections, it is only (re)created for a new tree
+    if (selection.refined.size() != tree.size())
+    {
+        selection.refined.assign(tree.size(), false);
+    }
+    select_lod_nodes(tree, 0, selection.refined[0], camera_position,
+                     projection_scale, max_pixel_error, hysteresis, selection);
+}
+
+bool color_lod(pmp::SurfaceMesh &mesh, const LodTree &tree,
+               const pmp::Point &camera_position, float projection_scale,
+               float max_pixel_error, LodSelection &selection)
+{
+    std::vector<int> previous_nodes;
+    std::swap(previous_nodes, selection.nodes);
+    select_lod_nodes(tree, camera_position, projection_scale, max_pixel_error,
+                     selection);
+    // small camera movements usually keep the cut (hysteresis), then the mesh is still up to date
+    if (selection.nodes == previous_nodes)
+    {
+        return false;
+    }
+
+    // show the simplified faces of all visible nodes
+    extract_nodes(tree, selection.nodes, mesh);
+    return true;
 }
 } // namespace meshlets
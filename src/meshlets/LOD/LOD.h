@@ -1,44 +1,145 @@
 #pragma once
 
 #include "../Meshlets.h"
+#include "../MeshletBounds.h"
 
 namespace meshlets {
 /**
- * @brief Returns all nodes of a certain level of the tree.
+ * @brief The LodTree data structure stores a tree of meshlets (needed for LOD) in flat arrays indexed by node (struct of arrays).
+ * Node 0 is the root. The nodes are stored level by level and the children of a node are stored next to each other:
+ * the children of node i are [first_child[i], first_child[i] + child_count[i]) and the nodes of level l are [level_offsets[l], level_offsets[l + 1]).
+ * The faces of all nodes are stored in a single array in node order (CSR layout), so the faces of a level are a permutation of the faces of its mesh
+ * and the faces of the children of a node are contiguous as well.
+*/
+typedef struct LodTree
+{
+    // parent of each node (-1 for the root)
+    std::vector<int> parent;
+    // first child of each node (-1 for nodes without children)
+    std::vector<int> first_child;
+    std::vector<int> child_count;
+    std::vector<int> level;
+    std::vector<pmp::Color> color;
+    // largest distance of the surface a node replaces (its children, recursively) to its simplified faces (0 for the finest level)
+    std::vector<float> error;
+    // bounding sphere and normal cone of the faces of each node
+    std::vector<MeshletBounds> bounds;
+    // sphere around the faces of each node and of all its descendants, the error is projected from it
+    // (so a node never projects a smaller error than its children)
+    std::vector<pmp::Point> lod_center;
+    std::vector<float> lod_radius;
+    // faces of all nodes, located on the mesh of their level: the faces of node i are node_faces[face_offsets[i], face_offsets[i + 1])
+    std::vector<pmp::Face> node_faces;
+    // first face of each node, with one additional trailing entry
+    std::vector<pmp::IndexType> face_offsets = {0};
+    // first node of each level, with one additional trailing entry
+    std::vector<int> level_offsets = {0};
+    // the input mesh simplified to each level (shared by all nodes of that level), v:source holds the input vertex of each vertex
+    std::vector<pmp::SurfaceMesh> meshes;
+
+    // number of nodes
+    size_t size() const { return parent.size(); }
+    bool empty() const { return size() == 0; }
+    // number of levels
+    int n_levels() const { return static_cast<int>(level_offsets.size()) - 1; }
+    // faces of a node (no copy is made)
+    FaceRange faces(int node) const
+    {
+        return FaceRange(node_faces.data() + face_offsets[node],
+                         node_faces.data() + face_offsets[node + 1]);
+    }
+    // mesh the faces of a node are located on
+    const pmp::SurfaceMesh &mesh(int node) const { return meshes[level[node]]; }
+
+    // removes all nodes and meshes
+    void clear();
+} LodTree;
+
+/**
+ * @brief The LodSelection data structure holds the nodes selected for the current camera (a cut through a LodTree)
+ * and the state needed to update the selection coherently for the next camera.
+*/
+typedef struct LodSelection
+{
+    // the selected nodes, every face of the finest level is covered by exactly one of them
+    std::vector<int> nodes;
+    // whether a node was replaced by its children in the last selection (only valid if its parent was replaced too)
+    std::vector<unsigned char> refined;
+} LodSelection;
+
+/**
+ * @brief Returns all nodes of a certain level of the tree (empty if the tree has no such level).
  * 
- * @param root The root of the tree
+ * @param tree The tree
  * @param level The level to get the nodes from
 */
-std::vector<TreeNode> get_nodes(TreeNode &root, int level);
+std::vector<int> get_nodes(const LodTree &tree, int level);
+
 /**
  * @brief Generates a tree of meshlets (needed for LOD).
+ * The faces of the mesh are split into num_level1_sites meshlets, each of them again into smaller ones, and so on.
+ * Afterwards the tree is simplified from the finest level up: the faces of the children of a node are decimated
+ * to about half their number, keeping the borders between the nodes fixed so neighboring nodes of any levels fit without cracks.
  * 
  * @param mesh The mesh to generate the tree on
  * @param num_levels Number of levels of the tree
  * @param num_level1_sites Number of sites in the first level of the tree
- * @return The root of the tree
+ * @param num_threads Number of threads the nodes of a level are split across, each node is clustered on a copy of its faces (default: 1, 0: all hardware threads)
+ * @return The tree, it only holds the root if the nodes become too small
 */
-TreeNode build_lod_tree(pmp::SurfaceMesh &mesh, int num_levels,
-                        int num_level1_sites);
+LodTree build_lod_tree(pmp::SurfaceMesh &mesh, int num_levels,
+                       int num_level1_sites, unsigned int num_threads = 1);
 
 /**
- * @brief Colors a certain level of the tree on the mesh.
+ * @brief Replaces a mesh by the faces of the given nodes (taken from the simplified mesh of their level). Each face gets the color of its node (f:color).
+ * Neighboring nodes share their border vertices, also if they are of different levels, so a cut through the tree is a connected mesh.
  * 
- * @param mesh The mesh to color
- * @param root The root of the tree
- * @param level The level to color
+ * @param tree The tree the nodes belong to
+ * @param nodes The nodes to extract
+ * @param result The mesh to replace
+*/
+void extract_nodes(const LodTree &tree, const std::vector<int> &nodes,
+                   pmp::SurfaceMesh &result);
+
+/**
+ * @brief Replaces the mesh by the simplified faces of a certain level of the tree, colored by node.
+ * 
+ * @param mesh The mesh to replace
+ * @param tree The tree
+ * @param level The level to show
+*/
+void color_level(pmp::SurfaceMesh &mesh, const LodTree &tree, int level);
+
+/**
+ * @brief Selects the nodes to show for a camera position by their screen space error.
+ * The tree is traversed from the root and a node is replaced by its children while its error, projected from the closest point of its lod sphere,
+ * is larger than max_pixel_error. A node that was refined in the last selection is only coarsened again once its projected error is below
+ * max_pixel_error * (1 - hysteresis), so small camera movements do not switch nodes back and forth.
+ * Only the selected nodes and their ancestors are visited.
+ * 
+ * @param tree The lod tree
+ * @param camera_position The position of the camera
+ * @param projection_scale Pixels per unit length at distance 1 (viewport height / (2 * tan(fovy / 2)))
+ * @param max_pixel_error The largest error in pixels that is accepted without refining
+ * @param selection The last selection, updated to the new one
+ * @param hysteresis Relative margin below max_pixel_error before a refined node is coarsened again (default: 0.2)
 */
-void color_level(pmp::SurfaceMesh &mesh, TreeNode &root, int level);
+void select_lod_nodes(const LodTree &tree, const pmp::Point &camera_position,
+                      float projection_scale, float max_pixel_error,
+                      LodSelection &selection, float hysteresis = 0.2f);
 
 /**
- * @brief Visualizes the level of detail on the mesh.
+ * @brief Visualizes the level of detail, i.e. selects the nodes for the camera (see select_lod_nodes) and replaces the mesh by their simplified faces.
  * 
  * @param mesh The mesh to visualize the lod on
- * @param root The root of the lod tree
+ * @param tree The lod tree
  * @param camera_position The position of the camera
- * @param currently_visible_nodes The currently visible nodes
+ * @param projection_scale Pixels per unit length at distance 1 (viewport height / (2 * tan(fovy / 2)))
+ * @param max_pixel_error The largest error in pixels that is accepted without refining
+ * @param selection The currently visible nodes, updated to the new selection (the mesh is only replaced if the nodes changed)
+ * @return true if the selected nodes changed and the mesh was replaced
 */
-void color_lod(pmp::SurfaceMesh &mesh, TreeNode &root,
-               pmp::vec3 &camera_position,
-               std::vector<meshlets::TreeNode> &currently_visible_nodes);
+bool color_lod(pmp::SurfaceMesh &mesh, const LodTree &tree,
+               const pmp::Point &camera_position, float projection_scale,
+               float max_pixel_error, LodSelection &selection);
 } // namespace meshlets
@@ -0,0 +1,171 @@
+#include "MeshletBounds.h"
+#include "GeometryCache.h"
+#include "../helpers/ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace meshlets {
+namespace {
+// computes the bounds with the given geometry cache, points is scratch space reused between calls
+MeshletBounds compute_bounds(pmp::SurfaceMesh &mesh, FaceRange faces,
+                             const GeometryCache &geometry,
+                             std::vector<pmp::Point> &points)
+{
+    MeshletBounds bounds;
+    bounds.center = pmp::Point(0, 0, 0);
+    bounds.radius = 0.0f;
+    bounds.cone_apex = bounds.center;
+    bounds.cone_axis = pmp::Normal(0, 0, 1);
+    bounds.cone_cutoff = 1.0f;
+    if (faces.empty())
+    {
+        return bounds;
+    }
+
+    // Ritter's bounding sphere: start with the most distant pair of the axis extreme points ...
+    points.clear();
+    for (auto face : faces)
+    {
+        for (auto vertex : mesh.vertices(face))
+        {
+            points.push_back(mesh.position(vertex));
+        }
+    }
+    size_t min_point[3] = {0, 0, 0};
+    size_t max_point[3] = {0, 0, 0};
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (points[i][axis] < points[min_point[axis]][axis])
+            {
+                min_point[axis] = i;
+            }
+            if (points[i][axis] > points[max_point[axis]][axis])
+            {
+                max_point[axis] = i;
+            }
+        }
+    }
+    int widest_axis = 0;
+    float widest_distance = 0.0f;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        float distance = pmp::sqrnorm(points[max_point[axis]] -
+                                      points[min_point[axis]]);
+        if (distance > widest_distance)
+        {
+            widest_distance = distance;
+            widest_axis = axis;
+        }
+    }
+    pmp::Point center = (points[min_point[widest_axis]] +
+                         points[max_point[widest_axis]]) *
+                        0.5f;
+    float radius = std::sqrt(widest_distance) * 0.5f;
+    // ... and grow it until it contains all points
+    for (auto &point : points)
+    {
+        float distance = pmp::norm(point - center);
+        if (distance > radius)
+        {
+            float shift = (distance - radius) * 0.5f;
+            center += (point - center) * (shift / distance);
+            radius += shift;
+        }
+    }
+    bounds.center = center;
+    bounds.radius = radius;
+
+    // normal cone around the mean face normal
+    pmp::Normal axis(0, 0, 0);
+    for (auto face : faces)
+    {
+        axis += geometry.normal(face);
+    }
+    float axis_length = pmp::norm(axis);
+    if (axis_length < 1e-6f)
+    {
+        return bounds;
+    }
+    axis /= axis_length;
+    bounds.cone_axis = axis;
+
+    float min_dot = 1.0f;
+    for (auto face : faces)
+    {
+        min_dot = std::min(min_dot, pmp::dot(axis, geometry.normal(face)));
+    }
+    // the cone is wider than ~84 degrees, culling would hardly ever succeed
+    if (min_dot <= 0.1f)
+    {
+        return bounds;
+    }
+
+    // move the apex back until it lies behind the planes of all faces
+    float max_t = 0.0f;
+    for (auto face : faces)
+    {
+        auto normal = geometry.normal(face);
+        float t = pmp::dot(center - geometry.centroid(face), normal) /
+                  pmp::dot(axis, normal);
+        max_t = std::max(max_t, t);
+    }
+    bounds.cone_apex = center - axis * max_t;
+    bounds.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    return bounds;
+}
+
+} // namespace
+
+MeshletBounds compute_bounds(pmp::SurfaceMesh &mesh, FaceRange faces)
+{
+    std::vector<pmp::Point> points;
+    return compute_bounds(mesh, faces, get_geometry_cache(mesh), points);
+}
+
+std::vector<MeshletBounds> compute_bounds(
+    pmp::SurfaceMesh &mesh, const std::vector<FaceRange> &face_ranges,
+    unsigned int num_threads)
+{
+    std::vector<MeshletBounds> bounds(face_ranges.size());
+    // compute the cache once up front, so the threads only read it
+    auto geometry = get_geometry_cache(mesh);
+    helpers::parallel_for(
+        face_ranges.size(), helpers::resolve_num_threads(num_threads),
+        [&](unsigned int, size_t begin, size_t end) {
+            std::vector<pmp::Point> points;
+            for (size_t i = begin; i < end; i++)
+            {
+                bounds[i] =
+                    compute_bounds(mesh, face_ranges[i], geometry, points);
+            }
+        });
+    return bounds;
+}
+
+std::vector<MeshletBounds> compute_meshlet_bounds(pmp::SurfaceMesh &mesh,
+                                                  Cluster &cluster,
+                                                  unsigned int num_threads)
+{
+    std::vector<FaceRange> face_ranges(cluster.size());
+    for (size_t i = 0; i < cluster.size(); i++)
+    {
+        face_ranges[i] = cluster[i].faces();
+    }
+    return compute_bounds(mesh, face_ranges, num_threads);
+}
+
+bool is_backfacing(const MeshletBounds &bounds,
+                   const pmp::Point &camera_position)
+{
+    pmp::Point view = bounds.cone_apex - camera_position;
+    float length = pmp::norm(view);
+    if (length == 0.0f)
+    {
+        return false;
+    }
+    return pmp::dot(view, bounds.cone_axis) >= bounds.cone_cutoff * length;
+}
+} // namespace meshlets
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Meshlets.h"
+
+namespace meshlets {
+/**
+ * @brief The MeshletBounds data structure holds the culling data of a meshlet: a bounding sphere and a backface normal cone.
+ * The meshlet faces away from a camera at position c if dot(normalize(cone_apex - c), cone_axis) >= cone_cutoff.
+*/
+typedef struct MeshletBounds
+{
+    // bounding sphere
+    pmp::Point center;
+    float radius;
+    // normal cone, a cutoff of 1 disables backface culling (the normals spread too much)
+    pmp::Point cone_apex;
+    pmp::Normal cone_axis;
+    float cone_cutoff;
+} MeshletBounds;
+
+/**
+ * @brief computes the bounding sphere (Ritter) and the normal cone of a set of faces, the face normals are taken from the geometry cache
+ * 
+ * @param mesh the mesh on which the faces are located
+ * @param faces the faces of the meshlet (or of a LOD node, e.g. tree.faces(node))
+*/
+MeshletBounds compute_bounds(pmp::SurfaceMesh &mesh, FaceRange faces);
+
+/**
+ * @brief computes the bounds of several sets of faces (e.g. the chunks of exported meshlets)
+ * 
+ * @param mesh the mesh on which the faces are located
+ * @param face_ranges the faces of each set
+ * @param num_threads the number of threads to use (default: 1, 0: all hardware threads)
+ * @return the bounds indexed like face_ranges
+*/
+std::vector<MeshletBounds>
+compute_bounds(pmp::SurfaceMesh &mesh,
+               const std::vector<FaceRange> &face_ranges,
+               unsigned int num_threads = 1);
+
+/**
+ * @brief computes the bounds of all meshlets of a cluster
+ * 
+ * @param mesh the mesh on which the cluster is located
+ * @param cluster the cluster to compute the bounds for
+ * @param num_threads the number of threads to use (default: 1, 0: all hardware threads)
+ * @return the bounds indexed by meshlet id
+*/
+std::vector<MeshletBounds> compute_meshlet_bounds(pmp::SurfaceMesh &mesh,
+                                                  Cluster &cluster,
+                                                  unsigned int num_threads = 1);
+
+/**
+ * @brief checks if all faces of a meshlet face away from the camera
+ * 
+ * @param bounds the bounds of the meshlet
+ * @param camera_position the position of the camera
+*/
+bool is_backfacing(const MeshletBounds &bounds,
+                   const pmp::Point &camera_position);
+} // namespace meshlets
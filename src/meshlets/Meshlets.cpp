@@ -1,47 +1,234 @@
 #include "Meshlets.h"
+#include "../helpers/ThreadPool.h"
 
+#include <algorithm>
+#include <deque>
 #include <iostream>
 #include <map>
+#include <numeric>
 
 namespace meshlets {
-bool operator==(const TreeNode &lhs, const TreeNode &rhs)
+void Cluster::clear()
 {
-    return lhs.id == rhs.id;
+    faces.clear();
+    iteration_offsets = {0};
+    meshlet_offsets = {0};
 }
 
-std::vector<pmp::Face> get_faces(Meshlet &meshlet)
+void Cluster::push_back(const Meshlet &meshlet)
 {
-    std::vector<pmp::Face> faces;
-    for (auto &iteration : meshlet)
+    // the faces of the meshlet would be invalidated by growing this cluster
+    assert(meshlet.cluster != this);
+
+    for (size_t iteration = 0; iteration < meshlet.n_iterations(); iteration++)
+    {
+        auto iteration_faces = meshlet.iteration(iteration);
+        faces.insert(faces.end(), iteration_faces.begin(),
+                     iteration_faces.end());
+        iteration_offsets.push_back(faces.size());
+    }
+    meshlet_offsets.push_back(iteration_offsets.size() - 1);
+}
+
+void Cluster::append(const Cluster &cluster, size_t first, size_t last)
+{
+    assert(&cluster != this);
+
+    auto first_slot = cluster.meshlet_offsets[first];
+    auto last_slot = cluster.meshlet_offsets[last];
+    auto first_face = cluster.iteration_offsets[first_slot];
+    auto last_face = cluster.iteration_offsets[last_slot];
+    // the copied offsets are moved from the position in the other cluster to the end of this one
+    pmp::IndexType slot_base = iteration_offsets.size() - 1;
+    pmp::IndexType face_base = faces.size();
+    faces.insert(faces.end(), cluster.faces.begin() + first_face,
+                 cluster.faces.begin() + last_face);
+    for (auto slot = first_slot + 1; slot <= last_slot; slot++)
+    {
+        iteration_offsets.push_back(cluster.iteration_offsets[slot] -
+                                    first_face + face_base);
+    }
+    for (auto meshlet_id = first + 1; meshlet_id <= last; meshlet_id++)
     {
-        for (auto &face : *iteration)
+        meshlet_offsets.push_back(cluster.meshlet_offsets[meshlet_id] -
+                                  first_slot + slot_base);
+    }
+}
+
+FaceMask::FaceMask(const pmp::SurfaceMesh &mesh, FaceRange faces)
+    : considered(mesh.faces_size(), 0)
+{
+    for (auto face : faces)
+    {
+        considered[face.idx()] = 1;
+    }
+}
+
+FaceRange get_faces(const Meshlet &meshlet)
+{
+    return meshlet.faces();
+}
+
+std::vector<pmp::Vertex> get_vertices(pmp::SurfaceMesh &mesh,
+                                      const Meshlet &meshlet)
+{
+    std::vector<pmp::Vertex> vertices;
+    vertices.reserve(meshlet.faces().size() * 3);
+    for (auto face : meshlet.faces())
+    {
+        for (auto vertex : mesh.vertices(face))
         {
-            faces.push_back(face);
+            vertices.push_back(vertex);
         }
     }
-    return faces;
+    std::sort(vertices.begin(), vertices.end());
+    vertices.erase(std::unique(vertices.begin(), vertices.end()),
+                   vertices.end());
+    return vertices;
 }
 
-pmp::Face get_site_face(Meshlet &meshlet)
+pmp::Face get_site_face(const Meshlet &meshlet)
 {
-    return meshlet.at(0)->at(0);
+    return meshlet.iteration(0)[0];
 }
 
-std::vector<pmp::Face> get_adjacent_faces(pmp::SurfaceMesh &mesh,
-                                          pmp::Face &face)
+Cluster build_cluster(pmp::SurfaceMesh &mesh,
+                      const std::vector<pmp::Face> &site_faces,
+                      FaceRange faces, unsigned int num_threads)
 {
-    std::vector<pmp::Face> adjacent_faces;
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    auto added_in_iteration =
+        mesh.get_face_property<int>("f:added_in_iteration");
+    assert(closest_site);
+    assert(added_in_iteration);
 
-    for (auto halfedge : mesh.halfedges(face))
+    Cluster cluster;
+    size_t num_meshlets = site_faces.size();
+
+    // the faces are processed in contiguous chunks, small inputs are not worth splitting
+    size_t min_faces_per_chunk = 16384;
+    unsigned int num_chunks = std::max<size_t>(
+        1, std::min<size_t>(helpers::resolve_num_threads(num_threads),
+                            faces.size() / min_faces_per_chunk));
+
+    // count the iterations of each meshlet (iteration 0 holds the site face)
+    std::vector<std::vector<pmp::IndexType>> chunk_num_iterations(
+        num_chunks, std::vector<pmp::IndexType>(num_meshlets, 1));
+    helpers::parallel_for(
+        faces.size(), num_chunks,
+        [&](unsigned int chunk, size_t begin, size_t end) {
+            auto &num_iterations = chunk_num_iterations[chunk];
+            for (size_t i = begin; i < end; i++)
+            {
+                auto face = faces[i];
+                if (closest_site[face] == -1)
+                {
+                    continue;
+                }
+                assert(added_in_iteration[face] > 0);
+                num_iterations[closest_site[face]] = std::max<pmp::IndexType>(
+                    num_iterations[closest_site[face]],
+                    added_in_iteration[face] + 1);
+            }
+        });
+
+    cluster.meshlet_offsets.resize(num_meshlets + 1);
+    for (size_t meshlet_id = 0; meshlet_id < num_meshlets; meshlet_id++)
     {
-        auto opposite_face = mesh.face(halfedge);
-        if (face == opposite_face)
+        pmp::IndexType num_iterations = 1;
+        for (auto &chunk_iterations : chunk_num_iterations)
         {
-            auto opposite_halfedge = mesh.opposite_halfedge(halfedge);
-            opposite_face = mesh.face(opposite_halfedge);
+            num_iterations =
+                std::max(num_iterations, chunk_iterations[meshlet_id]);
         }
+        cluster.meshlet_offsets[meshlet_id + 1] =
+            cluster.meshlet_offsets[meshlet_id] + num_iterations;
+    }
+
+    // count the faces of each iteration per chunk
+    size_t num_slots = cluster.meshlet_offsets.back();
+    std::vector<std::vector<pmp::IndexType>> chunk_positions(
+        num_chunks, std::vector<pmp::IndexType>(num_slots, 0));
+    helpers::parallel_for(
+        faces.size(), num_chunks,
+        [&](unsigned int chunk, size_t begin, size_t end) {
+            auto &counts = chunk_positions[chunk];
+            for (size_t i = begin; i < end; i++)
+            {
+                auto face = faces[i];
+                if (closest_site[face] == -1)
+                {
+                    continue;
+                }
+                counts[cluster.meshlet_offsets[closest_site[face]] +
+                       added_in_iteration[face]]++;
+            }
+        });
 
-        adjacent_faces.push_back(opposite_face);
+    // turn the counts into offsets, within an iteration the site face comes first and then the chunks in order
+    std::vector<unsigned char> holds_site(num_slots, 0);
+    for (size_t meshlet_id = 0; meshlet_id < num_meshlets; meshlet_id++)
+    {
+        holds_site[cluster.meshlet_offsets[meshlet_id]] = 1;
+    }
+    auto &iteration_offsets = cluster.iteration_offsets;
+    iteration_offsets.resize(num_slots + 1);
+    pmp::IndexType position = 0;
+    for (size_t slot = 0; slot < num_slots; slot++)
+    {
+        iteration_offsets[slot] = position;
+        position += holds_site[slot];
+        for (auto &positions : chunk_positions)
+        {
+            auto count = positions[slot];
+            positions[slot] = position;
+            position += count;
+        }
+    }
+    iteration_offsets[num_slots] = position;
+
+    // scatter the faces into their iteration
+    cluster.faces.resize(position);
+    for (size_t meshlet_id = 0; meshlet_id < num_meshlets; meshlet_id++)
+    {
+        cluster.faces[iteration_offsets[cluster.meshlet_offsets[meshlet_id]]] =
+            site_faces[meshlet_id];
+    }
+    helpers::parallel_for(
+        faces.size(), num_chunks,
+        [&](unsigned int chunk, size_t begin, size_t end) {
+            auto &positions = chunk_positions[chunk];
+            for (size_t i = begin; i < end; i++)
+            {
+                auto face = faces[i];
+                if (closest_site[face] == -1)
+                {
+                    continue;
+                }
+                cluster.faces[positions[cluster.meshlet_offsets
+                                            [closest_site[face]] +
+                                        added_in_iteration[face]]++] = face;
+            }
+        });
+
+    return cluster;
+}
+
+AdjacentFaces get_adjacent_faces(const pmp::SurfaceMesh &mesh,
+                                 pmp::Face face)
+{
+    AdjacentFaces adjacent_faces;
+
+    for (auto halfedge : mesh.halfedges(face))
+    {
+        auto opposite_halfedge = mesh.opposite_halfedge(halfedge);
+        if (mesh.is_boundary(opposite_halfedge))
+        {
+            continue;
+        }
+        assert(adjacent_faces.count < 3);
+        adjacent_faces.faces[adjacent_faces.count++] =
+            mesh.face(opposite_halfedge);
     }
 
     return adjacent_faces;
@@ -80,9 +267,10 @@ std::unordered_map<pmp::IndexType, bool> get_connected_faces(
 
     int site_face_id = get_meshlet_id(mesh, site_face);
 
+    std::vector<pmp::Face> faces_to_visit_next;
     while (faces_to_visit.size() > 0)
     {
-        std::vector<pmp::Face> faces_to_visit_next;
+        faces_to_visit_next.clear();
 
         for (auto &face : faces_to_visit)
         {
@@ -101,13 +289,13 @@ std::unordered_map<pmp::IndexType, bool> get_connected_faces(
                 }
             }
         }
-        faces_to_visit = faces_to_visit_next;
+        std::swap(faces_to_visit, faces_to_visit_next);
     }
 
     return connected_faces_map;
 }
 
-bool is_valid(pmp::SurfaceMesh &mesh, Meshlet &meshlet)
+bool is_valid(pmp::SurfaceMesh &mesh, const Meshlet &meshlet)
 {
     auto is_site = mesh.get_face_property<bool>("f:is_site");
     auto closest_site = mesh.get_face_property<int>("f:closest_site");
@@ -132,10 +320,10 @@ bool is_valid(pmp::SurfaceMesh &mesh, Meshlet &meshlet)
     // rule 3
     bool rule_3 = true;
     // skip 0 iteration, because it contains the legit meshlet's site
-    for (int num_iteration = 1; num_iteration < meshlet.size(); num_iteration++)
+    for (size_t num_iteration = 1; num_iteration < meshlet.n_iterations();
+         num_iteration++)
     {
-        auto iteration = meshlet.at(num_iteration);
-        for (auto &face : *iteration)
+        for (auto &face : meshlet.iteration(num_iteration))
         {
             if (is_site[face])
             {
@@ -151,6 +339,212 @@ bool is_valid(pmp::SurfaceMesh &mesh, Meshlet &meshlet)
     return rule_1_and_2 && rule_3 && rule_4;
 }
 
+namespace {
+// checks the rules of is_valid for all meshlets, given the edge connected components of faces with the same closest site.
+// component(face) returns the root of the component of a face (-1 if the face was not labeled), component_size is indexed by root
+template <typename Component>
+std::vector<bool> check_meshlets(pmp::SurfaceMesh &mesh, const Cluster &cluster,
+                                 Component component,
+                                 const std::vector<int> &component_size)
+{
+    auto is_site = mesh.get_face_property<bool>("f:is_site");
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    assert(is_site);
+    assert(closest_site);
+
+    std::vector<bool> valid(cluster.size(), false);
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        auto meshlet = cluster[meshlet_id];
+        auto faces = meshlet.faces();
+        // rule 4
+        if (faces.empty())
+        {
+            continue;
+        }
+        auto site_face = get_site_face(meshlet);
+        // if meshlet only consists of the site face, it is valid
+        if (faces.size() == 1 && is_site[site_face])
+        {
+            valid[meshlet_id] = true;
+            continue;
+        }
+
+        // rule 3
+        bool rule_3 = true;
+        for (size_t num_iteration = 1;
+             num_iteration < meshlet.n_iterations() && rule_3; num_iteration++)
+        {
+            for (auto face : meshlet.iteration(num_iteration))
+            {
+                if (is_site[face])
+                {
+                    rule_3 = false;
+                    break;
+                }
+            }
+        }
+
+        // rule 1 and 2: the faces reachable from the site face (as in get_connected_faces) are the
+        // components of its neighbors that belong to the meshlet id the site face is surrounded by
+        auto neighbors = get_adjacent_faces(mesh, site_face);
+        int num_neighbors = static_cast<int>(neighbors.size());
+        // same as get_meshlet_id
+        int surrounding_id = -1;
+        for (int i = 0; i < num_neighbors; i++)
+        {
+            if (surrounding_id == -1)
+            {
+                surrounding_id = closest_site[neighbors[i]];
+            }
+            else if (surrounding_id != closest_site[neighbors[i]])
+            {
+                surrounding_id = -1;
+                break;
+            }
+        }
+        int roots[3];
+        int num_roots = 0;
+        size_t num_connected = 0;
+        for (int i = 0; i < num_neighbors; i++)
+        {
+            int root = component(neighbors[i]);
+            if (root == -1 || closest_site[neighbors[i]] != surrounding_id)
+            {
+                continue;
+            }
+            if (std::find(roots, roots + num_roots, root) == roots + num_roots)
+            {
+                roots[num_roots++] = root;
+                num_connected += component_size[root];
+            }
+        }
+
+        valid[meshlet_id] = rule_3 && num_connected == faces.size() - 1;
+    }
+    return valid;
+}
+} // namespace
+
+std::vector<bool> validate_meshlets(pmp::SurfaceMesh &mesh,
+                                    const Cluster &cluster)
+{
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    assert(closest_site);
+
+    // label the edge connected components of faces with the same closest site (union-find)
+    std::vector<int> component(mesh.faces_size());
+    std::iota(component.begin(), component.end(), 0);
+    auto find = [&](int face) {
+        while (component[face] != face)
+        {
+            component[face] = component[component[face]];
+            face = component[face];
+        }
+        return face;
+    };
+    for (auto edge : mesh.edges())
+    {
+        if (mesh.is_boundary(edge))
+        {
+            continue;
+        }
+        auto face0 = mesh.face(mesh.halfedge(edge, 0));
+        auto face1 = mesh.face(mesh.halfedge(edge, 1));
+        if (closest_site[face0] != closest_site[face1])
+        {
+            continue;
+        }
+        auto root0 = find(face0.idx());
+        auto root1 = find(face1.idx());
+        if (root0 != root1)
+        {
+            component[std::max(root0, root1)] = std::min(root0, root1);
+        }
+    }
+    std::vector<int> component_size(mesh.faces_size(), 0);
+    for (auto face : mesh.faces())
+    {
+        component[face.idx()] = find(face.idx());
+        component_size[component[face.idx()]]++;
+    }
+
+    return check_meshlets(
+        mesh, cluster, [&](pmp::Face face) { return component[face.idx()]; },
+        component_size);
+}
+
+std::vector<bool> validate_meshlets(
+    pmp::SurfaceMesh &mesh, const Cluster &cluster,
+    const std::vector<pmp::Face> &faces_to_consider)
+{
+    // visiting the edges in order is faster than the adjacency of each face, if the faces cover the mesh anyway
+    if (faces_to_consider.size() == mesh.n_faces())
+    {
+        return validate_meshlets(mesh, cluster);
+    }
+
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    assert(closest_site);
+
+    // the index of each face in faces_to_consider (-1 for the other faces)
+    std::vector<int> compact_index(mesh.faces_size(), -1);
+    int num_faces = static_cast<int>(faces_to_consider.size());
+    for (int i = 0; i < num_faces; i++)
+    {
+        compact_index[faces_to_consider[i].idx()] = i;
+    }
+
+    // label the edge connected components of faces with the same closest site (union-find),
+    // every edge between two faces_to_consider is visited from the face with the lower index
+    std::vector<int> component(num_faces);
+    std::iota(component.begin(), component.end(), 0);
+    auto find = [&](int i) {
+        while (component[i] != i)
+        {
+            component[i] = component[component[i]];
+            i = component[i];
+        }
+        return i;
+    };
+    for (int i = 0; i < num_faces; i++)
+    {
+        auto face = faces_to_consider[i];
+        for (auto halfedge : mesh.halfedges(face))
+        {
+            // edges on the mesh boundary have no adjacent face
+            auto adjacent_face = mesh.face(mesh.opposite_halfedge(halfedge));
+            if (!adjacent_face.is_valid() || adjacent_face.idx() < face.idx() ||
+                closest_site[face] != closest_site[adjacent_face] ||
+                compact_index[adjacent_face.idx()] == -1)
+            {
+                continue;
+            }
+            auto root_i = find(i);
+            auto root_j = find(compact_index[adjacent_face.idx()]);
+            if (root_i != root_j)
+            {
+                component[std::max(root_i, root_j)] =
+                    std::min(root_i, root_j);
+            }
+        }
+    }
+    std::vector<int> component_size(num_faces, 0);
+    for (int i = 0; i < num_faces; i++)
+    {
+        component[i] = find(i);
+        component_size[component[i]]++;
+    }
+
+    return check_meshlets(
+        mesh, cluster,
+        [&](pmp::Face face) {
+            int i = compact_index[face.idx()];
+            return i == -1 ? -1 : component[i];
+        },
+        component_size);
+}
+
 void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster)
 {
     std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
@@ -158,6 +552,68 @@ void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster)
     validate_and_fix_meshlets(mesh, cluster, faces_to_consider);
 }
 
+namespace {
+// searches the faces of a meshlet that are edge connected to its site face (as get_connected_faces). The reached faces are
+// marked in an array indexed by face and only they are unmarked again, so a search only visits the meshlet
+typedef struct ConnectedFaces
+{
+    ConnectedFaces(pmp::SurfaceMesh &mesh)
+        : mesh(mesh), reached(mesh.faces_size(), 0)
+    {
+        closest_site = mesh.get_face_property<int>("f:closest_site");
+        assert(closest_site);
+    }
+
+    // searches from the site face, if the site face is not surrounded by its own meshlet no face is reached
+    void search(pmp::Face site_face, int meshlet_id)
+    {
+        clear();
+        if (get_meshlet_id(mesh, site_face) != meshlet_id)
+        {
+            return;
+        }
+        faces_to_visit.push_back(site_face);
+        while (!faces_to_visit.empty())
+        {
+            auto face = faces_to_visit.back();
+            faces_to_visit.pop_back();
+            for (auto adjacent_face : get_adjacent_faces(mesh, face))
+            {
+                if (closest_site[adjacent_face] == meshlet_id &&
+                    !reached[adjacent_face.idx()])
+                {
+                    reached[adjacent_face.idx()] = 1;
+                    faces.push_back(adjacent_face);
+                    faces_to_visit.push_back(adjacent_face);
+                }
+            }
+        }
+    }
+
+    // unmarks the faces reached by the last search
+    void clear()
+    {
+        for (auto face : faces)
+        {
+            reached[face.idx()] = 0;
+        }
+        faces.clear();
+    }
+
+    // whether the face was reached by the last search
+    bool operator[](pmp::Face face) const { return reached[face.idx()]; }
+
+    // the faces reached by the last search (the site face is not part of its meshlet and never reached)
+    std::vector<pmp::Face> faces;
+
+private:
+    pmp::SurfaceMesh &mesh;
+    pmp::FaceProperty<int> closest_site;
+    std::vector<unsigned char> reached;
+    std::vector<pmp::Face> faces_to_visit;
+} ConnectedFaces;
+} // namespace
+
 void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster,
                                std::vector<pmp::Face> &faces_to_consider)
 {
@@ -169,109 +625,366 @@ void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster,
     assert(closest_site);
     assert(added_in_iteration);
 
-    // convert faces_to_consider to a hashmap
-    std::unordered_map<pmp::IndexType, bool> faces_to_consider_map;
-    for (auto face : faces_to_consider)
+    // mark faces_to_consider in a dense mask
+    FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+    ConnectedFaces connected_faces(mesh);
+    // faces moved to a meshlet, as positions in cluster.faces (the cluster is only patched at the end, so its face lists get stale)
+    std::vector<std::vector<pmp::IndexType>> moved_in(cluster.size());
+    // meshlets that lost or gained faces, only their ranges are rebuilt at the end
+    std::vector<bool> changed(cluster.size(), false);
+    int num_changed = 0;
+    auto mark_changed = [&](int meshlet_id) {
+        if (!changed[meshlet_id])
+        {
+            changed[meshlet_id] = true;
+            num_changed++;
+        }
+    };
+
+    // only invalid meshlets and meshlets that lost or gained faces are (re)visited,
+    // every meshlet is visited at most max_num_visits times, so the fix always terminates
+    const int max_num_visits = 8;
+    std::vector<int> num_visits(cluster.size(), 0);
+    std::vector<bool> queued(cluster.size(), false);
+    std::deque<int> dirty_meshlets;
+    auto mark_dirty = [&](int meshlet_id) {
+        if (!queued[meshlet_id] && num_visits[meshlet_id] < max_num_visits)
+        {
+            queued[meshlet_id] = true;
+            dirty_meshlets.push_back(meshlet_id);
+        }
+    };
+
+    auto valid = validate_meshlets(mesh, cluster, faces_to_consider);
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
     {
-        faces_to_consider_map[face.idx()] = true;
+        if (!valid[meshlet_id])
+        {
+            mark_dirty(meshlet_id);
+        }
     }
-    int max_num_dryruns = 5;
-    int current_num_dryruns = 0;
-    int unchanged_faces = 1;
 
-    while (unchanged_faces > 0 && current_num_dryruns < max_num_dryruns)
+    // moves the face at the given position in cluster.faces to another meshlet
+    auto move_face = [&](pmp::IndexType position, int from, int to) {
+        closest_site[cluster.faces[position]] = to;
+        moved_in[to].push_back(position);
+        mark_changed(from);
+        mark_changed(to);
+        mark_dirty(to);
+    };
+
+    // the meshlet of each site face, only built if needed
+    std::unordered_map<pmp::IndexType, int> site_meshlet_ids;
+    auto site_meshlet_id = [&](pmp::Face site_face) {
+        if (site_meshlet_ids.empty())
+        {
+            for (size_t meshlet_id = 0; meshlet_id < cluster.size();
+                 meshlet_id++)
+            {
+                site_meshlet_ids[get_site_face(cluster[meshlet_id]).idx()] =
+                    meshlet_id;
+            }
+        }
+        auto it = site_meshlet_ids.find(site_face.idx());
+        return it == site_meshlet_ids.end() ? -1 : it->second;
+    };
+
+    // the position of a face in cluster.faces, the face is listed in the range of its meshlet or was moved to it
+    auto find_position = [&](pmp::Face face) {
+        int meshlet_id = closest_site[face];
+        auto first =
+            cluster.iteration_offsets[cluster.meshlet_offsets[meshlet_id]];
+        auto last = first + cluster[meshlet_id].faces().size();
+        for (auto position = first; position < last; position++)
+        {
+            if (cluster.faces[position] == face)
+            {
+                return position;
+            }
+        }
+        for (auto position : moved_in[meshlet_id])
+        {
+            if (cluster.faces[position] == face)
+            {
+                return position;
+            }
+        }
+        assert(false);
+        return first;
+    };
+    // a face next to a site face is connected to the meshlet of the site, if the other neighbors of the
+    // site face belong to that meshlet (as get_meshlet_id, without the face)
+    auto site_vote = [&](pmp::Face site_face, pmp::Face face) {
+        int meshlet_id = site_meshlet_id(site_face);
+        if (meshlet_id == -1)
+        {
+            return -1;
+        }
+        for (auto adjacent_face : get_adjacent_faces(mesh, site_face))
+        {
+            if (adjacent_face != face &&
+                closest_site[adjacent_face] != meshlet_id)
+            {
+                return -1;
+            }
+        }
+        return meshlet_id;
+    };
+
+    // Majority vote of the neighbors of a face (ties go to the lower meshlet id), -1 if no neighbor belongs to another meshlet
+    auto majority_vote = [&](pmp::Face face, int meshlet_id) {
+        std::pair<int, int> votes[3];
+        int num_votes = 0;
+        for (auto adjacent_face : get_adjacent_faces(mesh, face))
+        {
+            if (!faces_to_consider_mask[adjacent_face])
+            {
+                continue;
+            }
+            int vote = is_site[adjacent_face]
+                           ? site_vote(adjacent_face, face)
+                           : closest_site[adjacent_face];
+            if (vote == -1 || vote == meshlet_id)
+            {
+                continue;
+            }
+            int i = 0;
+            while (i < num_votes && votes[i].first != vote)
+            {
+                i++;
+            }
+            if (i == num_votes)
+            {
+                votes[num_votes++] = {vote, 0};
+            }
+            votes[i].second++;
+        }
+        if (num_votes == 0)
+        {
+            return -1;
+        }
+        auto best = votes[0];
+        for (int i = 1; i < num_votes; i++)
+        {
+            if (votes[i].second > best.second ||
+                (votes[i].second == best.second && votes[i].first < best.first))
+            {
+                best = votes[i];
+            }
+        }
+        return best.first;
+    };
+
+    // on open meshes a face can be cut off by the boundary and site faces whose neighbors belong to different
+    // meshlets. The other neighbors of such a site face are moved to the meshlet of the site, so the face can
+    // join it. Returns the meshlet of the site (-1 if no site next to the face allows this)
+    auto claim_site_neighbors = [&](pmp::Face face) {
+        for (auto site_face : get_adjacent_faces(mesh, face))
+        {
+            if (!is_site[site_face] || !faces_to_consider_mask[site_face])
+            {
+                continue;
+            }
+            int meshlet_id = site_meshlet_id(site_face);
+            auto neighbors = get_adjacent_faces(mesh, site_face);
+            bool claimable = meshlet_id != -1;
+            for (auto adjacent_face : neighbors)
+            {
+                claimable = claimable &&
+                            (adjacent_face == face ||
+                             (!is_site[adjacent_face] &&
+                              faces_to_consider_mask[adjacent_face] &&
+                              closest_site[adjacent_face] != -1));
+            }
+            if (!claimable)
+            {
+                continue;
+            }
+            for (auto adjacent_face : neighbors)
+            {
+                int from = closest_site[adjacent_face];
+                if (adjacent_face != face && from != meshlet_id)
+                {
+                    move_face(find_position(adjacent_face), from, meshlet_id);
+                    mark_dirty(from);
+                }
+            }
+            return meshlet_id;
+        }
+        return -1;
+    };
+
+    std::vector<pmp::IndexType> members;
+    std::vector<pmp::IndexType> unconnected;
+    while (!dirty_meshlets.empty())
     {
-        unchanged_faces = 0;
+        int meshlet_id = dirty_meshlets.front();
+        dirty_meshlets.pop_front();
+        queued[meshlet_id] = false;
+        num_visits[meshlet_id]++;
 
-        for (auto &meshlet : cluster)
+        // search the faces that are edge connected to the site face, if the site face is not
+        // surrounded by its own meshlet no face is connected and the meshlet is dissolved
+        connected_faces.search(get_site_face(cluster[meshlet_id]),
+                               meshlet_id);
+
+        // the current faces of the meshlet that are not connected to its site face
+        auto first =
+            cluster.iteration_offsets[cluster.meshlet_offsets[meshlet_id]];
+        members.resize(cluster[meshlet_id].faces().size());
+        std::iota(members.begin(), members.end(), first);
+        members.insert(members.end(), moved_in[meshlet_id].begin(),
+                       moved_in[meshlet_id].end());
+        unconnected.clear();
+        for (auto position : members)
         {
-            auto faces = get_faces(*meshlet);
-            auto site_face = get_site_face(*meshlet);
-            auto connected_faces = get_connected_faces(mesh, site_face);
+            auto face = cluster.faces[position];
+            // skip sites, faces that were moved to another meshlet and connected faces
+            if (!is_site[face] && closest_site[face] == meshlet_id &&
+                !connected_faces[face])
+            {
+                unconnected.push_back(position);
+            }
+        }
 
-            if (connected_faces.size() != faces.size() - 1)
+        // faces surrounded by faces of the same meshlet get free once their neighbors are moved,
+        // so the remaining faces are voted on again until no face moves
+        bool moved = true;
+        while (moved && !unconnected.empty())
+        {
+            moved = false;
+            size_t num_remaining = 0;
+            for (auto position : unconnected)
             {
-                // meshlet is invalid
-                for (auto &face : faces)
+                auto face = cluster.faces[position];
+                // a face can be listed twice if it was moved back
+                if (closest_site[face] != meshlet_id)
                 {
-                    if (is_site[face])
-                    {
-                        continue;
-                    }
+                    continue;
+                }
+                int vote = majority_vote(face, meshlet_id);
+                if (vote == -1)
+                {
+                    unconnected[num_remaining++] = position;
+                    continue;
+                }
+                // move the face to the new meshlet (for now it keeps the iteration number)
+                move_face(position, meshlet_id, vote);
+                moved = true;
+            }
+            unconnected.resize(num_remaining);
 
-                    if (connected_faces.find(face.idx()) ==
-                        connected_faces.end())
+            // the remaining faces only border the boundary, sites and each other
+            for (size_t i = 0; i < unconnected.size() && !moved; i++)
+            {
+                int claimed =
+                    claim_site_neighbors(cluster.faces[unconnected[i]]);
+                moved = claimed != -1;
+                if (claimed == meshlet_id)
+                {
+                    // the site face is surrounded by its meshlet again, so faces may be connected now
+                    connected_faces.search(get_site_face(cluster[meshlet_id]),
+                                           meshlet_id);
+                    size_t num_unconnected = 0;
+                    for (auto position : unconnected)
                     {
-                        // Majority vote
-                        std::unordered_map<int, int> closest_site_count;
-                        for (auto &adjacent_face :
-                             get_adjacent_faces(mesh, face))
-                        {
-                            if (is_site[adjacent_face] ||
-                                closest_site[adjacent_face] ==
-                                    closest_site[face] ||
-                                faces_to_consider_map.find(
-                                    adjacent_face.idx()) ==
-                                    faces_to_consider_map.end())
-                            {
-                                continue;
-                            }
-                            if (closest_site_count.find(
-                                    closest_site[adjacent_face]) ==
-                                closest_site_count.end())
-                            {
-                                closest_site_count
-                                    [closest_site[adjacent_face]] = 1;
-                            }
-                            else
-                            {
-                                closest_site_count
-                                    [closest_site[adjacent_face]]++;
-                            }
-                        }
-                        // if face is not surrounded by faces of the same meshlet
-                        if (closest_site_count.size() > 0)
-                        {
-                            int max_count = 0;
-                            int max_count_site_id = -1;
-                            for (auto &pair : closest_site_count)
-                            {
-                                if (pair.second > max_count)
-                                {
-                                    max_count = pair.second;
-                                    max_count_site_id = pair.first;
-                                }
-                            }
-                            auto new_meshlet = cluster[max_count_site_id];
-                            auto old_meshlet = cluster[closest_site[face]];
-                            // remove face from old site
-                            old_meshlet->at(added_in_iteration[face])
-                                ->erase(
-                                    std::remove(
-                                        meshlet->at(added_in_iteration[face])
-                                            ->begin(),
-                                        meshlet->at(added_in_iteration[face])
-                                            ->end(),
-                                        face),
-                                    meshlet->at(added_in_iteration[face])
-                                        ->end());
-                                        
-                            // add face to new site (for now it keeps the iteration number)
-                            new_meshlet->at(added_in_iteration[face])
-                                ->push_back(face);
-                            closest_site[face] = max_count_site_id;
-                            current_num_dryruns = 0;
-                        }
-                        else
+                        if (!connected_faces[cluster.faces[position]])
                         {
-                            unchanged_faces++;
-                            current_num_dryruns++;
+                            unconnected[num_unconnected++] = position;
                         }
                     }
+                    unconnected.resize(num_unconnected);
                 }
             }
         }
+        if (!unconnected.empty())
+        {
+            mark_dirty(meshlet_id);
+        }
+    }
+
+    if (num_changed == 0)
+    {
+        return;
+    }
+
+    // rebuild the ranges of the changed meshlets, the runs of unchanged meshlets in between are copied as blocks.
+    // Within an iteration the faces keep their order in cluster.faces (as in build_cluster)
+    Cluster fixed_cluster;
+    fixed_cluster.faces.reserve(cluster.faces.size());
+    fixed_cluster.iteration_offsets.reserve(cluster.iteration_offsets.size());
+    fixed_cluster.meshlet_offsets.reserve(cluster.meshlet_offsets.size());
+    std::vector<std::pair<int, pmp::IndexType>> iterations_and_positions;
+    size_t num_copied = 0;
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        if (!changed[meshlet_id])
+        {
+            continue;
+        }
+        fixed_cluster.append(cluster, num_copied, meshlet_id);
+        num_copied = meshlet_id + 1;
+        auto meshlet = cluster[meshlet_id];
+
+        // the faces that are still part of the meshlet (a face can be listed twice if it was moved back)
+        iterations_and_positions.clear();
+        auto first =
+            cluster.iteration_offsets[cluster.meshlet_offsets[meshlet_id]];
+        for (pmp::IndexType position = first;
+             position < first + meshlet.faces().size(); position++)
+        {
+            auto face = cluster.faces[position];
+            if (closest_site[face] == (int)meshlet_id)
+            {
+                iterations_and_positions.push_back(
+                    {added_in_iteration[face], position});
+            }
+        }
+        // the own faces are already sorted by iteration and position, the moved faces are merged in
+        auto num_own = iterations_and_positions.size();
+        for (auto position : moved_in[meshlet_id])
+        {
+            auto face = cluster.faces[position];
+            if (closest_site[face] == (int)meshlet_id)
+            {
+                iterations_and_positions.push_back(
+                    {added_in_iteration[face], position});
+            }
+        }
+        std::sort(iterations_and_positions.begin() + num_own,
+                  iterations_and_positions.end());
+        std::inplace_merge(iterations_and_positions.begin(),
+                           iterations_and_positions.begin() + num_own,
+                           iterations_and_positions.end());
+        iterations_and_positions.erase(
+            std::unique(iterations_and_positions.begin(),
+                        iterations_and_positions.end()),
+            iterations_and_positions.end());
+
+        // iteration 0 only holds the site face
+        fixed_cluster.faces.push_back(get_site_face(meshlet));
+        fixed_cluster.iteration_offsets.push_back(fixed_cluster.faces.size());
+        int iteration = 1;
+        for (auto &iteration_and_position : iterations_and_positions)
+        {
+            for (; iteration < iteration_and_position.first; iteration++)
+            {
+                fixed_cluster.iteration_offsets.push_back(
+                    fixed_cluster.faces.size());
+            }
+            fixed_cluster.faces.push_back(
+                cluster.faces[iteration_and_position.second]);
+        }
+        if (!iterations_and_positions.empty())
+        {
+            fixed_cluster.iteration_offsets.push_back(
+                fixed_cluster.faces.size());
+        }
+        fixed_cluster.meshlet_offsets.push_back(
+            fixed_cluster.iteration_offsets.size() - 1);
     }
+    fixed_cluster.append(cluster, num_copied, cluster.size());
+    cluster = std::move(fixed_cluster);
 }
 
 bool check_consistency(pmp::SurfaceMesh &mesh, Cluster &cluster)
@@ -286,14 +999,13 @@ bool check_consistency(pmp::SurfaceMesh &mesh, Cluster &cluster)
 
     std::unordered_map<pmp::IndexType, bool> seen_faces;
 
-    for (int site_id = 0; site_id < cluster.size(); site_id++)
+    for (size_t site_id = 0; site_id < cluster.size(); site_id++)
     {
         auto meshlet = cluster[site_id];
-        for (int iteration_num = 0; iteration_num < meshlet->size();
+        for (size_t iteration_num = 0; iteration_num < meshlet.n_iterations();
              iteration_num++)
         {
-            auto iteration = meshlet->at(iteration_num);
-            for (auto &face : *iteration)
+            for (auto &face : meshlet.iteration(iteration_num))
             {
                 // check if faces occur multiple times, which means they are part of multiple meshlets
                 if (seen_faces.find(face.idx()) == seen_faces.end())
@@ -314,8 +1026,8 @@ bool check_consistency(pmp::SurfaceMesh &mesh, Cluster &cluster)
                 }
                 else
                 {
-                    if (closest_site[face] != site_id ||
-                        added_in_iteration[face] != iteration_num)
+                    if (closest_site[face] != (int)site_id ||
+                        added_in_iteration[face] != (int)iteration_num)
                     {
                         return false;
                     }
@@ -8,14 +8,127 @@
 #include <vector>
 
 namespace meshlets {
+struct Cluster;
+
+/**
+ * @brief The FaceRange data structure is a non-owning view on a contiguous range of faces (e.g. one iteration or all faces of a meshlet).
+*/
+typedef struct FaceRange
+{
+    const pmp::Face *first;
+    const pmp::Face *last;
+
+    // default constructor (empty range)
+    FaceRange() : first(nullptr), last(nullptr){};
+    // constructor
+    FaceRange(const pmp::Face *first, const pmp::Face *last)
+        : first(first), last(last){};
+    // view on all faces of a vector
+    FaceRange(const std::vector<pmp::Face> &faces)
+        : first(faces.data()), last(faces.data() + faces.size()){};
+
+    const pmp::Face *begin() const { return first; }
+    const pmp::Face *end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    const pmp::Face &operator[](size_t i) const { return first[i]; }
+} FaceRange;
+
+/**
+ * @brief The Meshlet data structure is a view on a single meshlet of a Cluster. A meshlet consists of iterations, where each iteration holds the faces added in that iteration. The first (0) iteration only holds the site_face.
+*/
+typedef struct Meshlet
+{
+    const Cluster *cluster;
+    // id of the meshlet (index into the cluster)
+    size_t id;
+
+    Meshlet(const Cluster *cluster, size_t id) : cluster(cluster), id(id){};
+
+    // number of iterations of the meshlet
+    size_t n_iterations() const;
+    // faces added in the given iteration
+    FaceRange iteration(size_t iteration) const;
+    // all faces of the meshlet (in iteration order)
+    FaceRange faces() const;
+} Meshlet;
+
 /**
- * @brief The Meshlet data structure is a vector of iterations, where each iteration is a vector of faces. The first (0) iteration only holds the site_face.
+ * @brief The Cluster data structure stores all meshlets in flat arrays (CSR layout):
+ * faces holds the faces of all meshlets, grouped by meshlet and by iteration.
+ * The faces of iteration j of meshlet i are faces[iteration_offsets[meshlet_offsets[i] + j], iteration_offsets[meshlet_offsets[i] + j + 1]).
+ * Both offset arrays hold one additional trailing entry, so they are never empty.
 */
-typedef std::vector<std::shared_ptr<std::vector<pmp::Face>>> Meshlet;
+typedef struct Cluster
+{
+    std::vector<pmp::Face> faces;
+    std::vector<pmp::IndexType> iteration_offsets = {0};
+    std::vector<pmp::IndexType> meshlet_offsets = {0};
+
+    // number of meshlets
+    size_t size() const { return meshlet_offsets.size() - 1; }
+    bool empty() const { return size() == 0; }
+    Meshlet operator[](size_t id) const { return Meshlet(this, id); }
+
+    // removes all meshlets
+    void clear();
+    // appends a copy of a meshlet of another cluster
+    void push_back(const Meshlet &meshlet);
+    // appends copies of the meshlets [first, last) of another cluster (as one block)
+    void append(const Cluster &cluster, size_t first, size_t last);
+} Cluster;
+
+inline size_t Meshlet::n_iterations() const
+{
+    return cluster->meshlet_offsets[id + 1] - cluster->meshlet_offsets[id];
+}
+
+inline FaceRange Meshlet::iteration(size_t iteration) const
+{
+    auto slot = cluster->meshlet_offsets[id] + iteration;
+    return FaceRange(cluster->faces.data() + cluster->iteration_offsets[slot],
+                     cluster->faces.data() +
+                         cluster->iteration_offsets[slot + 1]);
+}
+
+inline FaceRange Meshlet::faces() const
+{
+    return FaceRange(
+        cluster->faces.data() +
+            cluster->iteration_offsets[cluster->meshlet_offsets[id]],
+        cluster->faces.data() +
+            cluster->iteration_offsets[cluster->meshlet_offsets[id + 1]]);
+}
+
+/**
+ * @brief The FaceMask data structure marks a subset of the faces of a mesh in a dense array indexed by face, so membership tests are a single indexed load.
+ * Nothing is stored on the mesh.
+*/
+typedef struct FaceMask
+{
+    FaceMask(const pmp::SurfaceMesh &mesh, FaceRange faces);
+
+    // whether the face is part of the subset
+    bool operator[](pmp::Face face) const { return considered[face.idx()]; }
+
+private:
+    std::vector<unsigned char> considered;
+} FaceMask;
+
 /**
- * @brief The Cluster data structure is a vector of Meshlets.
+ * @brief The AdjacentFaces data structure holds the (up to 3) faces sharing an edge with a triangle in a fixed size array, so iterating the adjacency never allocates.
 */
-typedef std::vector<std::shared_ptr<Meshlet>> Cluster;
+typedef struct AdjacentFaces
+{
+    pmp::Face faces[3];
+    unsigned int count = 0;
+
+    const pmp::Face *begin() const { return faces; }
+    const pmp::Face *end() const { return faces + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const pmp::Face &operator[](size_t i) const { return faces[i]; }
+} AdjacentFaces;
 
 /**
  * @brief The Site data structure holds the information of a site.
@@ -54,34 +167,52 @@ typedef struct ClusterAndSites
 } ClusterAndSites;
 
 /**
- * @brief The TreeNode data structure is used to store a tree of meshlets (needed for LOD).
+ * @brief The MeshletLimits data structure holds the maximum size of a meshlet (the defaults match common mesh shader limits).
 */
-typedef struct TreeNode
+typedef struct MeshletLimits
 {
-    int id;
-    pmp::Color color;
-    std::shared_ptr<TreeNode> parent;
-    std::shared_ptr<std::vector<TreeNode>> children;
-    std::shared_ptr<std::vector<pmp::Face>> faces;
-    int level;
-} TreeNode;
-bool operator==(const TreeNode &lhs, const TreeNode &rhs);
+    // maximum number of distinct vertices per meshlet
+    int max_vertices = 64;
+    // maximum number of triangles per meshlet
+    int max_triangles = 124;
+} MeshletLimits;
 
 /**
- * @brief helper function to get all the faces of a meshlet in a flat vector
+ * @brief helper function to get all the faces of a meshlet (no copy is made)
  * 
  * @param meshlet the meshlet to get the faces from
 */
-std::vector<pmp::Face> get_faces(Meshlet &meshlet);
+FaceRange get_faces(const Meshlet &meshlet);
+
+/**
+ * @brief helper function to get the distinct vertices of a meshlet (sorted by index)
+ * 
+ * @param mesh the mesh on which the meshlet is located
+ * @param meshlet the meshlet to get the vertices from
+*/
+std::vector<pmp::Vertex> get_vertices(pmp::SurfaceMesh &mesh,
+                                      const Meshlet &meshlet);
 
 /**
- * @brief helper function to get all 3 adjacent faces of a face
+ * @brief builds the flat cluster data structure from the face properties f:closest_site and f:added_in_iteration
+ * 
+ * @param mesh the mesh on which the cluster is located
+ * @param site_faces the site_face of each meshlet (indexed by meshlet id)
+ * @param faces the faces to sort into the meshlets (site faces and faces without a closest site are skipped), the order within an iteration is kept
+ * @param num_threads the number of threads to use (default: 1, 0 uses all hardware threads), the result does not depend on it
+*/
+Cluster build_cluster(pmp::SurfaceMesh &mesh,
+                      const std::vector<pmp::Face> &site_faces,
+                      FaceRange faces, unsigned int num_threads = 1);
+
+/**
+ * @brief helper function to get the adjacent faces of a triangle (edges on the mesh boundary have no adjacent face and are skipped)
  * 
  * @param mesh the mesh on which the face is located
  * @param face the face to get the adjacent faces from
 */
-std::vector<pmp::Face> get_adjacent_faces(pmp::SurfaceMesh &mesh,
-                                          pmp::Face &face);
+AdjacentFaces get_adjacent_faces(const pmp::SurfaceMesh &mesh,
+                                 pmp::Face face);
 
 /**
  * @brief check if the meshlet is valid according to the following rules:
@@ -93,7 +224,32 @@ std::vector<pmp::Face> get_adjacent_faces(pmp::SurfaceMesh &mesh,
  * @param mesh the mesh on which the meshlet is located
  * @param meshlet the meshlet to check
 */
-bool is_valid(pmp::SurfaceMesh &mesh, Meshlet &meshlet);
+bool is_valid(pmp::SurfaceMesh &mesh, const Meshlet &meshlet);
+
+/**
+ * @brief checks all meshlets of a cluster with the rules of is_valid in a single pass over the mesh.
+ * The edge connected components of faces with the same f:closest_site are labeled once (union-find), so no search per meshlet is needed.
+ * Boundary edges are skipped.
+ * 
+ * @param mesh the mesh on which the cluster is located
+ * @param cluster the cluster to check
+ * @return the validity of each meshlet (indexed by meshlet id)
+*/
+std::vector<bool> validate_meshlets(pmp::SurfaceMesh &mesh,
+                                    const Cluster &cluster);
+
+/**
+ * @brief checks all meshlets of a cluster that covers a subset of the mesh with the rules of is_valid.
+ * Only the edges between faces_to_consider are visited, the size of the mesh only adds the fill of a per-call index array.
+ *
+ * @param mesh the mesh on which the cluster is located
+ * @param cluster the cluster to check
+ * @param faces_to_consider the faces that were considered during clustering
+ * @return the validity of each meshlet (indexed by meshlet id)
+*/
+std::vector<bool> validate_meshlets(
+    pmp::SurfaceMesh &mesh, const Cluster &cluster,
+    const std::vector<pmp::Face> &faces_to_consider);
 
 /**
  * @brief checks for each meshlet in the cluster if it's valid and performs a fix if not
@@ -106,6 +262,12 @@ void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster);
 /**
  * @brief checks for each meshlet in the cluster if it's valid and performs a fix if not
  * 
+ * The meshlets are validated with validate_meshlets on faces_to_consider.
+ * Only the invalid meshlets and the meshlets that received faces from them are
+ * revisited, each at most a fixed number of times. At the end only the ranges of the meshlets that lost or gained faces are rebuilt.
+ * A face that only borders the mesh boundary and site faces joins the meshlet of such a site, whose other neighbors are moved to that meshlet.
+ * This is not possible if the site face also borders another site face, then the meshlet stays invalid (sites are never moved).
+ * 
  * @param mesh the mesh on which the cluster is located
  * @param cluster the cluster to check and fix
  * @param faces_to_consider the faces that were considered during clustering
@@ -118,7 +280,7 @@ void validate_and_fix_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster,
  * 
  * @param meshlet the meshlet to get the site_face from
 */
-pmp::Face get_site_face(Meshlet &meshlet);
+pmp::Face get_site_face(const Meshlet &meshlet);
 
 /**
  * @brief helper function to get the meshlet id of a meshlet given the site_face
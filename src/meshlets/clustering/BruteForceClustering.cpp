@@ -1,8 +1,14 @@
-#include "pmp/algorithms/differential_geometry.h"
 #include "BruteForceClustering.h"
+#include "KdTree.h"
+#include "SitePositions.h"
+#include "../GeometryCache.h"
+#include "../../helpers/ThreadPool.h"
+
+#include <memory>
 
 namespace meshlets {
-Cluster brute_force_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites)
+Cluster brute_force_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                          NearestSiteSearch search, unsigned int num_threads)
 {
     // create a face property to store the closest site
     pmp::FaceProperty<int> closest_site;
@@ -37,39 +43,73 @@ Cluster brute_force_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites)
     auto is_site = mesh.get_face_property<bool>("f:is_site");
     assert(is_site);
 
-    Cluster cluster(sites.size());
-    for (auto &site : sites)
-    {
-        auto meshlet = std::make_shared<Meshlet>(2);
-        // create vectors for the two iterations
-        meshlet->at(0) = std::make_shared<std::vector<pmp::Face>>();
-        meshlet->at(1) = std::make_shared<std::vector<pmp::Face>>();
+    auto geometry = get_geometry_cache(mesh);
 
-        meshlet->at(0)->push_back(site.face);
-        cluster[site.id] = meshlet;
+    // set up the selected nearest site search (read only, so it can be shared by all threads)
+    std::unique_ptr<KdTree> kd_tree;
+    std::unique_ptr<SitePositions> site_positions;
+    if (search == NearestSiteSearch::KdTree)
+    {
+        kd_tree = std::make_unique<KdTree>(sites);
     }
-
-    for (auto face : mesh.faces())
+    else if (search == NearestSiteSearch::Simd)
     {
-        if (is_site[face])
+        site_positions = std::make_unique<SitePositions>(sites);
+    }
+
+    // returns the index of the closest site in the sites vector (-1 if there is none)
+    auto find_closest_site = [&](const pmp::Point &centroid) {
+        float min_distance = std::numeric_limits<float>::max();
+        if (kd_tree)
         {
-            continue;
+            return kd_tree->closest_site(centroid, min_distance);
         }
-        auto centroid = pmp::centroid(mesh, face);
-        float min_distance = std::numeric_limits<float>::max();
-        for (auto &site : sites)
+        if (site_positions)
         {
-            float distance = pmp::distance(centroid, site.position);
+            return site_positions->closest_site(centroid, min_distance);
+        }
+        int closest = -1;
+        for (size_t i = 0; i < sites.size(); i++)
+        {
+            float distance = pmp::distance(centroid, sites[i].position);
             if (distance < min_distance)
             {
                 min_distance = distance;
-                closest_site[face] = site.id;
-                added_in_iteration[face] = 1;
+                closest = i;
             }
         }
-        // add face to the meshlet of the closest site
-        cluster[closest_site[face]]->at(1)->push_back(face);
+        return closest;
+    };
+
+    // every face only writes its own properties, so the faces can be split into independent ranges
+    unsigned int num_chunks = helpers::resolve_num_threads(num_threads);
+    helpers::parallel_for(
+        mesh.faces_size(), num_chunks,
+        [&](unsigned int, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+            {
+                pmp::Face face(i);
+                if (mesh.is_deleted(face) || is_site[face])
+                {
+                    continue;
+                }
+                int closest = find_closest_site(geometry.centroid(face));
+                if (closest != -1)
+                {
+                    closest_site[face] = sites[closest].id;
+                    added_in_iteration[face] = 1;
+                }
+            }
+        });
+
+    // sort the faces into the meshlet of their closest site
+    std::vector<pmp::Face> site_faces(sites.size());
+    for (auto &site : sites)
+    {
+        site_faces[site.id] = site.face;
     }
+    std::vector<pmp::Face> faces(mesh.faces_begin(), mesh.faces_end());
+    Cluster cluster = build_cluster(mesh, site_faces, faces, num_threads);
 
     return cluster;
 }
@@ -4,11 +4,28 @@
 
 namespace meshlets {
 /**
- * @brief perform a clustering using brute force (i.e. compare each face to each site) 
+ * @brief The NearestSiteSearch enum selects how the closest site of a face is found.
+*/
+enum class NearestSiteSearch
+{
+    // compare each face to each site
+    Linear,
+    // query a kd-tree over the site positions (same result as Linear)
+    KdTree,
+    // compare each face to each site with SIMD instructions on squared distances
+    Simd
+};
+
+/**
+ * @brief perform a clustering using brute force (i.e. assign each face to the closest site) 
  * 
  * @param mesh the mesh to calculate the cluster on
  * @param sites the sites to use for the clustering
+ * @param search how the closest site is found (default: Linear)
+ * @param num_threads the number of threads the faces are split across (default: 1, 0 uses all hardware threads). The resulting cluster does not depend on it.
  * @return Cluster the resulting cluster
 */
-Cluster brute_force_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites);
+Cluster brute_force_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                          NearestSiteSearch search = NearestSiteSearch::Linear,
+                          unsigned int num_threads = 1);
 } // namespace meshlets
\ No newline at end of file
@@ -1,73 +1,84 @@
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
 #include <map>
+#include <numeric>
+#include <queue>
 
 #include "./GrowSites.h"
-#include "pmp/algorithms/differential_geometry.h"
-#include "pmp/algorithms/normals.h"
+#include "../GeometryCache.h"
 #include "../../helpers/CubicBezier.h"
+#include "../../helpers/ThreadPool.h"
+#include "pmp/algorithms/utilities.h"
 
 namespace meshlets {
-Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
-                   int max_iterations)
+namespace {
+// normal penalty for the angle between the normal of the site and the normal of the face (both normalized)
+float normal_penalty(const pmp::Normal &site_normal,
+                     const pmp::Normal &face_normal)
 {
-    std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
-                                             mesh.faces_end());
-    return grow_sites(mesh, sites, faces_to_consider, max_iterations);
+    float max_penalty = 2.0f;
+    float min_penalty = 0.7f;
+    // control points for the cubic bezier curve of the angle between the normal of the site and the normal of the face
+    helpers::Point p0(0.0f, max_penalty);
+    helpers::Point p1(1.0f, max_penalty);
+    helpers::Point p2(0.75f, max_penalty);
+    helpers::Point p3(1.0f, min_penalty);
+    return helpers::cubicBezier((pmp::dot(site_normal, face_normal) + 1) / 2,
+                                p0, p1, p2, p3)
+        .y;
 }
 
-Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
-                   std::vector<pmp::Face> &faces_to_consider,
-                   int max_iterations)
+// gets or adds the face property with the given name and resets it to -1
+pmp::FaceProperty<int> reset_face_property(pmp::SurfaceMesh &mesh,
+                                           const std::string &name)
 {
-    // create a face property to store the closest site
-    pmp::FaceProperty<int> closest_site;
-    if (!mesh.has_face_property("f:closest_site"))
-    {
-        closest_site = mesh.add_face_property<int>("f:closest_site", -1);
-    }
-    else
-    {
-        closest_site = mesh.get_face_property<int>("f:closest_site");
-        for (auto face : mesh.faces())
-        {
-            closest_site[face] = -1;
-        }
-    }
-    // create a face property to store the iteration in which the face was added
-    pmp::FaceProperty<int> added_in_iteration;
-    if (!mesh.has_face_property("f:added_in_iteration"))
+    if (!mesh.has_face_property(name))
     {
-        added_in_iteration =
-            mesh.add_face_property<int>("f:added_in_iteration", -1);
+        return mesh.add_face_property<int>(name, -1);
     }
-    else
+    auto property = mesh.get_face_property<int>(name);
+    std::fill(property.vector().begin(), property.vector().end(), -1);
+    return property;
+}
+
+// a face reached by a site, ordered by penalized distance (ties go to the lower site id and face index)
+typedef struct Candidate
+{
+    float cost;
+    int site;
+    pmp::IndexType face;
+    int iteration;
+
+    bool operator>(const Candidate &other) const
     {
-        added_in_iteration =
-            mesh.get_face_property<int>("f:added_in_iteration");
-        for (auto face : mesh.faces())
+        if (cost != other.cost)
         {
-            added_in_iteration[face] = -1;
+            return cost > other.cost;
         }
-    }
-    // create a vertex property to store the visited state of that vertex
-    pmp::VertexProperty<int> visited_by;
-    if (!mesh.has_vertex_property("v:visited_by"))
-    {
-        visited_by = mesh.add_vertex_property<int>("v:visited_by", -1);
-    }
-    else
-    {
-        visited_by = mesh.get_vertex_property<int>("v:visited_by");
-        for (auto vertex : mesh.vertices())
+        if (site != other.site)
         {
-            visited_by[vertex] = -1;
+            return site > other.site;
         }
+        return face > other.face;
     }
-    // convert faces_to_consider to a hashmap
-    std::unordered_map<pmp::IndexType, bool> faces_to_consider_map;
-    for (auto face : faces_to_consider)
-    {
-        faces_to_consider_map[face.idx()] = true;
-    }
+} Candidate;
+
+// grows the active sites (ids in ascending order) over the faces of the mask, f:closest_site and f:added_in_iteration
+// of these faces and v:visited_by of their vertices have to be reset to -1 before
+void grow_active_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                       const std::vector<int> &active_sites,
+                       const FaceMask &faces_to_consider_mask,
+                       int max_iterations)
+{
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    auto added_in_iteration =
+        mesh.get_face_property<int>("f:added_in_iteration");
+    auto visited_by = mesh.get_vertex_property<int>("v:visited_by");
+    assert(closest_site);
+    assert(added_in_iteration);
+    assert(visited_by);
 
     // get face property indicating whether a face is a site (this is set in the site generation)
     pmp::FaceProperty<bool> is_site = mesh.get_face_property<bool>("f:is_site");
@@ -75,51 +86,51 @@ Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
     int current_iteration = 0;
     int mean_faces_added_per_iteration = 100;
 
-    Cluster cluster(sites.size());
-    for (auto &site : sites)
+    // faces added per site in the previous and in the current iteration (the growth front)
+    std::vector<std::vector<pmp::Face>> faces_added_in_previous_iteration(
+        sites.size());
+    std::vector<std::vector<pmp::Face>> faces_added_in_current_iteration(
+        sites.size());
+    for (int site_id : active_sites)
     {
-        cluster[site.id] = std::make_shared<Meshlet>();
+        faces_added_in_previous_iteration[site_id].reserve(
+            mean_faces_added_per_iteration);
+        faces_added_in_current_iteration[site_id].reserve(
+            mean_faces_added_per_iteration);
     }
 
-    // normal penalty for the angle between the normal of the site and the normal of the face
-    float max_penalty = 2.0f;
-    float min_penalty = 0.7f;
-    // control points for the cubic bezier curve of the angle between the normal of the site and the normal of the face
-    helpers::Point p0(0.0f, max_penalty);
-    helpers::Point p1(1.0f, max_penalty);
-    helpers::Point p2(0.75f, max_penalty);
-    helpers::Point p3(1.0f, min_penalty);
+    // per face centroids and normals
+    auto geometry = get_geometry_cache(mesh);
+    // normalized site normals
+    std::vector<pmp::Normal> site_normals(sites.size());
+    for (auto &site : sites)
+    {
+        site_normals[site.id] = pmp::normalize(site.normal);
+    }
 
     int changed = 1;
     while (changed > 0 && current_iteration <= max_iterations)
     {
         changed = 0;
-        for (auto &site : sites)
-        {
-            // get the data structure for the current site
-            auto &faces_added_per_iteration = cluster[site.id];
-            // create a vector to store the faces added in the current iteration
-            auto faces_added_in_current_iteration =
-                std::make_shared<std::vector<pmp::Face>>();
-            faces_added_in_current_iteration->reserve(
-                mean_faces_added_per_iteration);
+        for (int site_id : active_sites)
+        {
+            auto &site = sites[site_id];
+            // get the vector to store the faces added in the current iteration
+            auto &faces_added_by_site = faces_added_in_current_iteration[site.id];
             if (current_iteration == 0)
             {
-                faces_added_in_current_iteration->push_back(site.face);
+                faces_added_by_site.push_back(site.face);
                 changed++;
-                faces_added_per_iteration->push_back(
-                    faces_added_in_current_iteration);
             }
             else
             {
                 // get the faces added in the previous iteration
-                auto &faces_added_in_previous_iteration =
-                    faces_added_per_iteration->at(current_iteration - 1);
+                auto &faces_added_by_site_before =
+                    faces_added_in_previous_iteration[site.id];
 
-                for (int i = 0; i < faces_added_in_previous_iteration->size();
-                     i++)
+                for (size_t i = 0; i < faces_added_by_site_before.size(); i++)
                 {
-                    pmp::Face face = faces_added_in_previous_iteration->at(i);
+                    pmp::Face face = faces_added_by_site_before.at(i);
                     // get the vertecies
                     for (auto v : mesh.vertices(face))
                     {
@@ -130,8 +141,7 @@ Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
                             for (auto f : mesh.faces(v))
                             {
                                 // check if the face is in faces_to_consider
-                                if (faces_to_consider_map.find(f.idx()) ==
-                                    faces_to_consider_map.end())
+                                if (!faces_to_consider_mask[f])
                                 {
                                     continue;
                                 }
@@ -144,73 +154,71 @@ Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
                                         closest_site[f] = site.id;
                                         added_in_iteration[f] =
                                             current_iteration;
-                                        faces_added_in_current_iteration
-                                            ->push_back(f);
+                                        faces_added_by_site.push_back(f);
                                         changed++;
                                     }
                                     // face belongs to another site
                                     else
                                     {
-                                        auto other_site =
+                                        auto &other_site =
                                             sites[closest_site[f]];
-                                        auto site_normal = site.normal;
-                                        site_normal.normalize();
-                                        auto other_site_normal =
-                                            other_site.normal;
-                                        other_site_normal.normalize();
                                         auto face_normal =
-                                            pmp::face_normal(mesh, f);
-                                        face_normal.normalize();
-
-                                        float penalty_site =
-                                            helpers::cubicBezier(
-                                                (pmp::dot(site_normal,
-                                                          face_normal) +
-                                                 1) /
-                                                    2,
-                                                p0, p1, p2, p3)
-                                                .y;
+                                            geometry.normal(f);
+                                        auto face_centroid =
+                                            geometry.centroid(f);
 
+                                        float penalty_site = normal_penalty(
+                                            site_normals[site.id],
+                                            face_normal);
                                         float penalty_other_site =
-                                            helpers::cubicBezier(
-                                                (pmp::dot(other_site_normal,
-                                                          face_normal) +
-                                                 1) /
-                                                    2,
-                                                p0, p1, p2, p3)
-                                                .y;
+                                            normal_penalty(
+                                                site_normals[other_site.id],
+                                                face_normal);
 
                                         if (penalty_site *
-                                                pmp::distance(
-                                                    site.position,
-                                                    pmp::centroid(mesh, f)) <
+                                                pmp::distance(site.position,
+                                                              face_centroid) <
                                             penalty_other_site *
                                                 pmp::distance(
                                                     other_site.position,
-                                                    pmp::centroid(mesh, f)))
+                                                    face_centroid))
                                         {
-                                            // remove the face from the other site
-                                            auto &
-                                                faces_added_in_previous_iteration_other_site =
-                                                    cluster[other_site.id]->at(
-                                                        added_in_iteration[f]);
-
-                                            faces_added_in_previous_iteration_other_site
-                                                ->erase(
+                                            // remove the face from the growth front of the other site (older iterations are only
+                                            // stored in the face properties and do not need to be updated)
+                                            std::vector<pmp::Face>
+                                                *faces_added_by_other_site =
+                                                    nullptr;
+                                            if (added_in_iteration[f] ==
+                                                current_iteration)
+                                            {
+                                                faces_added_by_other_site =
+                                                    &faces_added_in_current_iteration
+                                                        [other_site.id];
+                                            }
+                                            else if (added_in_iteration[f] ==
+                                                     current_iteration - 1)
+                                            {
+                                                faces_added_by_other_site =
+                                                    &faces_added_in_previous_iteration
+                                                        [other_site.id];
+                                            }
+                                            if (faces_added_by_other_site)
+                                            {
+                                                faces_added_by_other_site->erase(
                                                     std::remove(
-                                                        faces_added_in_previous_iteration_other_site
+                                                        faces_added_by_other_site
                                                             ->begin(),
-                                                        faces_added_in_previous_iteration_other_site
+                                                        faces_added_by_other_site
                                                             ->end(),
                                                         f),
-                                                    faces_added_in_previous_iteration_other_site
+                                                    faces_added_by_other_site
                                                         ->end());
+                                            }
                                             // take the face
                                             closest_site[f] = site.id;
                                             added_in_iteration[f] =
                                                 current_iteration;
-                                            faces_added_in_current_iteration
-                                                ->push_back(f);
+                                            faces_added_by_site.push_back(f);
                                             changed++;
                                         }
                                     }
@@ -219,12 +227,884 @@ Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
                         }
                     }
                 }
-                faces_added_per_iteration->push_back(
-                    faces_added_in_current_iteration);
             }
         }
+        // the current iteration becomes the previous one
+        std::swap(faces_added_in_previous_iteration,
+                  faces_added_in_current_iteration);
+        for (int site_id : active_sites)
+        {
+            faces_added_in_current_iteration[site_id].clear();
+        }
         current_iteration++;
     }
+}
+} // namespace
+
+Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                   int max_iterations)
+{
+    std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
+                                             mesh.faces_end());
+    return grow_sites(mesh, sites, faces_to_consider, max_iterations);
+}
+
+Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                   std::vector<pmp::Face> &faces_to_consider,
+                   int max_iterations)
+{
+    // create a face property to store the closest site
+    reset_face_property(mesh, "f:closest_site");
+    // create a face property to store the iteration in which the face was added
+    reset_face_property(mesh, "f:added_in_iteration");
+    // create a vertex property to store the visited state of that vertex
+    if (!mesh.has_vertex_property("v:visited_by"))
+    {
+        mesh.add_vertex_property<int>("v:visited_by", -1);
+    }
+    else
+    {
+        auto visited_by = mesh.get_vertex_property<int>("v:visited_by");
+        std::fill(visited_by.vector().begin(), visited_by.vector().end(), -1);
+    }
+
+    // grow all sites
+    std::vector<int> active_sites(sites.size());
+    std::iota(active_sites.begin(), active_sites.end(), 0);
+    {
+        // mark faces_to_consider in a dense mask
+        FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+        grow_active_sites(mesh, sites, active_sites, faces_to_consider_mask,
+                          max_iterations);
+    }
+
+    // sort the faces into the meshlets of their closest site
+    std::vector<pmp::Face> site_faces(sites.size());
+    for (auto &site : sites)
+    {
+        site_faces[site.id] = site.face;
+    }
+    Cluster cluster = build_cluster(mesh, site_faces, faces_to_consider);
+
     return cluster;
 }
-} // namespace meshlets
\ No newline at end of file
+
+Cluster regrow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                     const std::vector<int> &moved_sites,
+                     const Cluster &cluster,
+                     std::vector<pmp::Face> &faces_to_consider,
+                     int max_iterations)
+{
+    auto closest_site = mesh.get_face_property<int>("f:closest_site");
+    auto added_in_iteration =
+        mesh.get_face_property<int>("f:added_in_iteration");
+    auto visited_by = mesh.get_vertex_property<int>("v:visited_by");
+    assert(closest_site);
+    assert(added_in_iteration);
+    assert(visited_by);
+
+    // the moved sites and the sites whose meshlets share a vertex with theirs are grown again
+    std::vector<bool> is_active(sites.size(), false);
+    for (int site_id : moved_sites)
+    {
+        is_active[site_id] = true;
+    }
+    {
+        // only faces_to_consider belong to the cluster, the closest site of other faces may be stale
+        FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+        for (int site_id : moved_sites)
+        {
+            for (auto face : get_faces(cluster[site_id]))
+            {
+                for (auto v : mesh.vertices(face))
+                {
+                    for (auto f : mesh.faces(v))
+                    {
+                        if (faces_to_consider_mask[f] && closest_site[f] != -1)
+                        {
+                            is_active[closest_site[f]] = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    std::vector<int> active_sites;
+    std::vector<pmp::Face> region;
+    for (int site_id = 0; site_id < (int)sites.size(); site_id++)
+    {
+        if (!is_active[site_id])
+        {
+            continue;
+        }
+        active_sites.push_back(site_id);
+        auto faces = get_faces(cluster[site_id]);
+        region.insert(region.end(), faces.begin(), faces.end());
+    }
+
+    // reset the faces of the active meshlets (including the old site faces) and their vertices
+    for (auto face : region)
+    {
+        closest_site[face] = -1;
+        added_in_iteration[face] = -1;
+        for (auto v : mesh.vertices(face))
+        {
+            visited_by[v] = -1;
+        }
+    }
+    {
+        // the active sites only grow into the faces of their previous meshlets
+        FaceMask region_mask(mesh, region);
+        grow_active_sites(mesh, sites, active_sites, region_mask,
+                          max_iterations);
+    }
+    // pieces of the previous meshlets that are only connected to the others can not be reached from
+    // the active sites, this is rare and a full clustering is done instead
+    auto is_site = mesh.get_face_property<bool>("f:is_site");
+    for (auto face : region)
+    {
+        if (!is_site[face] && closest_site[face] == -1)
+        {
+            return grow_sites(mesh, sites, faces_to_consider, max_iterations);
+        }
+    }
+
+    // sort the faces into the meshlets of their closest site
+    std::vector<pmp::Face> site_faces(sites.size());
+    for (auto &site : sites)
+    {
+        site_faces[site.id] = site.face;
+    }
+    return build_cluster(mesh, site_faces, faces_to_consider);
+}
+
+Cluster grow_sites_parallel(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            int max_iterations, unsigned int num_threads)
+{
+    std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
+                                             mesh.faces_end());
+    return grow_sites_parallel(mesh, sites, faces_to_consider, max_iterations,
+                               num_threads);
+}
+
+Cluster grow_sites_parallel(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            std::vector<pmp::Face> &faces_to_consider,
+                            int max_iterations, unsigned int num_threads)
+{
+    // create a face property to store the closest site
+    auto closest_site = reset_face_property(mesh, "f:closest_site");
+    // create a face property to store the iteration in which the face was added
+    auto added_in_iteration = reset_face_property(mesh, "f:added_in_iteration");
+    // mark faces_to_consider in a dense mask
+    FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+
+    // get face property indicating whether a face is a site (this is set in the site generation)
+    pmp::FaceProperty<bool> is_site = mesh.get_face_property<bool>("f:is_site");
+    assert(is_site);
+
+    // per face centroids and normals
+    auto geometry = get_geometry_cache(mesh);
+    // normalized site normals
+    std::vector<pmp::Normal> site_normals(sites.size());
+    for (auto &site : sites)
+    {
+        site_normals[site.id] = pmp::normalize(site.normal);
+    }
+    // penalized distance of a face to a site, the site with the lower cost wins the face
+    auto cost = [&](int site_id, pmp::Face face) {
+        return normal_penalty(site_normals[site_id], geometry.normal(face)) *
+               pmp::distance(sites[site_id].position, geometry.centroid(face));
+    };
+
+    // a site asking for a face in the current iteration
+    typedef struct
+    {
+        pmp::IndexType face;
+        int site;
+        float cost;
+    } Proposal;
+
+    // sites are split into chunks that propose in parallel, the proposals are sorted into
+    // buckets of contiguous face indices, so every face is resolved by exactly one chunk
+    unsigned int num_chunks = helpers::resolve_num_threads(num_threads);
+    size_t num_faces = mesh.faces_size();
+    std::vector<std::vector<std::vector<Proposal>>> proposals(
+        num_chunks, std::vector<std::vector<Proposal>>(num_chunks));
+    auto bucket_of = [&](pmp::IndexType face) {
+        return static_cast<unsigned int>(static_cast<size_t>(face) *
+                                         num_chunks / num_faces);
+    };
+    // best proposal per face, only valid while the face is being resolved
+    std::vector<float> best_cost(num_faces);
+    std::vector<int> best_site(num_faces, -1);
+    // penalized distance of every face to its closest site
+    std::vector<float> closest_cost(num_faces);
+    // distinct vertices around the growth front of every site (sorted). Only the vertices that were not around
+    // the previous front are visited, the others never yield a new proposal, since the faces around them were
+    // already proposed and the costs of their closest sites only decrease
+    std::vector<std::vector<pmp::Vertex>> front_vertices(sites.size());
+    // the vertices around the current front of the site a chunk is proposing for
+    std::vector<std::vector<pmp::Vertex>> chunk_vertices(num_chunks);
+    // faces won in the current iteration per bucket (sorted by face index)
+    std::vector<std::vector<pmp::Face>> won_faces(num_chunks);
+
+    // faces won per site in the previous iteration (the growth front)
+    std::vector<std::vector<pmp::Face>> front(sites.size());
+    for (auto &site : sites)
+    {
+        front[site.id].push_back(site.face);
+    }
+
+    int current_iteration = 1;
+    size_t changed = sites.size();
+    while (changed > 0 && current_iteration <= max_iterations)
+    {
+        // every site proposes the faces around its front it would take (the mesh is only read)
+        helpers::parallel_for(
+            sites.size(), num_chunks,
+            [&](unsigned int chunk, size_t begin, size_t end) {
+                auto &chunk_proposals = proposals[chunk];
+                auto &vertices = chunk_vertices[chunk];
+                for (size_t site_id = begin; site_id < end; site_id++)
+                {
+                    int site = static_cast<int>(site_id);
+                    auto &previous_vertices = front_vertices[site];
+                    vertices.clear();
+                    for (auto face : front[site])
+                    {
+                        for (auto v : mesh.vertices(face))
+                        {
+                            vertices.push_back(v);
+                        }
+                    }
+                    std::sort(vertices.begin(), vertices.end());
+                    vertices.erase(
+                        std::unique(vertices.begin(), vertices.end()),
+                        vertices.end());
+                    auto previous = previous_vertices.begin();
+                    for (auto v : vertices)
+                    {
+                        // both lists are sorted
+                        while (previous != previous_vertices.end() &&
+                               *previous < v)
+                        {
+                            previous++;
+                        }
+                        if (previous != previous_vertices.end() &&
+                            *previous == v)
+                        {
+                            continue;
+                        }
+                        for (auto f : mesh.faces(v))
+                        {
+                            if (!faces_to_consider_mask[f] || is_site[f] ||
+                                closest_site[f] == site)
+                            {
+                                continue;
+                            }
+                            float site_cost = cost(site, f);
+                            // a face of another site is only proposed if this site is closer
+                            if (closest_site[f] != -1 &&
+                                !(site_cost < closest_cost[f.idx()]))
+                            {
+                                continue;
+                            }
+                            chunk_proposals[bucket_of(f.idx())].push_back(
+                                {f.idx(), site, site_cost});
+                        }
+                    }
+                    std::swap(previous_vertices, vertices);
+                }
+            });
+
+        // every face goes to its cheapest proposal (ties go to the lower site id),
+        // this is a total order, so the result does not depend on the number of threads
+        helpers::parallel_for(
+            num_chunks, num_chunks,
+            [&](unsigned int, size_t begin, size_t end) {
+                for (size_t bucket = begin; bucket < end; bucket++)
+                {
+                    auto &won = won_faces[bucket];
+                    won.clear();
+                    for (auto &chunk_proposals : proposals)
+                    {
+                        for (auto &proposal : chunk_proposals[bucket])
+                        {
+                            int &site = best_site[proposal.face];
+                            float &site_cost = best_cost[proposal.face];
+                            if (site == -1)
+                            {
+                                won.emplace_back(proposal.face);
+                            }
+                            if (site == -1 || proposal.cost < site_cost ||
+                                (proposal.cost == site_cost &&
+                                 proposal.site < site))
+                            {
+                                site = proposal.site;
+                                site_cost = proposal.cost;
+                            }
+                        }
+                        chunk_proposals[bucket].clear();
+                    }
+                    std::sort(won.begin(), won.end());
+                    for (auto face : won)
+                    {
+                        closest_site[face] = best_site[face.idx()];
+                        closest_cost[face.idx()] = best_cost[face.idx()];
+                        added_in_iteration[face] = current_iteration;
+                        best_site[face.idx()] = -1;
+                    }
+                }
+            });
+
+        // the won faces become the new growth front of their sites
+        changed = 0;
+        for (auto &faces : front)
+        {
+            faces.clear();
+        }
+        for (auto &won : won_faces)
+        {
+            for (auto face : won)
+            {
+                front[closest_site[face]].push_back(face);
+            }
+            changed += won.size();
+        }
+        current_iteration++;
+    }
+
+    // sort the faces into the meshlets of their closest site
+    std::vector<pmp::Face> site_faces(sites.size());
+    for (auto &site : sites)
+    {
+        site_faces[site.id] = site.face;
+    }
+    return build_cluster(mesh, site_faces, faces_to_consider, num_threads);
+}
+
+Cluster grow_sites_priority(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            int max_iterations)
+{
+    std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
+                                             mesh.faces_end());
+    return grow_sites_priority(mesh, sites, faces_to_consider, max_iterations);
+}
+
+Cluster grow_sites_priority(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            std::vector<pmp::Face> &faces_to_consider,
+                            int max_iterations)
+{
+    // create a face property to store the closest site
+    auto closest_site = reset_face_property(mesh, "f:closest_site");
+    // create a face property to store the iteration in which the face was added (here the number of edges crossed from the site)
+    auto added_in_iteration = reset_face_property(mesh, "f:added_in_iteration");
+    // mark faces_to_consider in a dense mask
+    FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+
+    // get face property indicating whether a face is a site (this is set in the site generation)
+    pmp::FaceProperty<bool> is_site = mesh.get_face_property<bool>("f:is_site");
+    assert(is_site);
+
+    // per face centroids and normals
+    auto geometry = get_geometry_cache(mesh);
+    // normalized site normals
+    std::vector<pmp::Normal> site_normals(sites.size());
+    for (auto &site : sites)
+    {
+        site_normals[site.id] = pmp::normalize(site.normal);
+    }
+
+    // the faces reached by the sites are queued in buckets of the quantized penalized distance and every bucket is
+    // processed in the order of the face indices, which keeps the memory accesses local (a global heap interleaves
+    // the growth fronts of all sites). The order is exact up to the bucket width.
+    float bucket_width = 0.5f * pmp::mean_edge_length(mesh);
+    // degenerate meshes (all vertices at one point, invalid coordinates) have no usable edge length
+    if (!(bucket_width > 0.0f) || !std::isfinite(bucket_width))
+    {
+        bucket_width = 1.0f;
+    }
+    std::vector<std::vector<pmp::IndexType>> buckets;
+    size_t current_bucket = 0;
+    // costs beyond the last bucket (or not finite) go into the last bucket
+    const size_t max_bucket = std::max<size_t>(mesh.faces_size(), 1);
+    auto bucket_index = [&](float cost) {
+        float bucket = cost / bucket_width;
+        // also true for NaN
+        if (!(bucket < static_cast<float>(max_bucket)))
+        {
+            return max_bucket;
+        }
+        return static_cast<size_t>(std::max(bucket, 0.0f));
+    };
+
+    // best candidate queued per face, worse candidates are not queued at all
+    std::vector<Candidate> queued(
+        mesh.faces_size(),
+        {std::numeric_limits<float>::max(), -1, PMP_MAX_INDEX, -1});
+
+    // pushes the faces sharing an edge with the given face of the site (so the meshlets stay edge connected)
+    auto push_neighbors = [&](int site_id, pmp::Face face, int iteration) {
+        if (iteration > max_iterations)
+        {
+            return;
+        }
+        auto &site = sites[site_id];
+        for (auto f : get_adjacent_faces(mesh, face))
+        {
+            // skip faces that are finalized or already queued by this site
+            auto &candidate = queued[f.idx()];
+            if (!faces_to_consider_mask[f] || is_site[f] ||
+                closest_site[f] != -1 || candidate.site == site_id)
+            {
+                continue;
+            }
+            float cost =
+                normal_penalty(site_normals[site_id], geometry.normal(f)) *
+                pmp::distance(site.position, geometry.centroid(f));
+            if (candidate.site != -1 &&
+                (cost > candidate.cost ||
+                 (cost == candidate.cost && site_id >= candidate.site)))
+            {
+                continue;
+            }
+            candidate = {cost, site_id, f.idx(), iteration};
+            // faces cheaper than the current bucket (the cost is not monotone along the growth) go into the current one
+            size_t bucket = std::max(current_bucket, bucket_index(cost));
+            if (bucket >= buckets.size())
+            {
+                buckets.resize(bucket + 1);
+            }
+            buckets[bucket].push_back(f.idx());
+        }
+    };
+
+    for (auto &site : sites)
+    {
+        push_neighbors(site.id, site.face, 1);
+    }
+
+    // every face is finalized by the site of its cheapest candidate when its bucket is processed
+    std::vector<pmp::IndexType> batch;
+    for (current_bucket = 0; current_bucket < buckets.size(); current_bucket++)
+    {
+        // faces pushed into the current bucket while it is processed form the next batch
+        while (!buckets[current_bucket].empty())
+        {
+            batch.clear();
+            std::swap(batch, buckets[current_bucket]);
+            std::sort(batch.begin(), batch.end());
+            for (auto idx : batch)
+            {
+                pmp::Face face(idx);
+                // skip faces that are finalized (also duplicates queued by several sites)
+                if (closest_site[face] != -1)
+                {
+                    continue;
+                }
+                auto candidate = queued[idx];
+                closest_site[face] = candidate.site;
+                added_in_iteration[face] = candidate.iteration;
+                push_neighbors(candidate.site, face, candidate.iteration + 1);
+            }
+        }
+    }
+
+    // sort the faces into the meshlets of their closest site
+    std::vector<pmp::Face> site_faces(sites.size());
+    for (auto &site : sites)
+    {
+        site_faces[site.id] = site.face;
+    }
+    return build_cluster(mesh, site_faces, faces_to_consider);
+}
+
+ClusterAndSites grow_sites_constrained(pmp::SurfaceMesh &mesh,
+                                       std::vector<Site> &sites,
+                                       MeshletLimits limits)
+{
+    std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
+                                             mesh.faces_end());
+    return grow_sites_constrained(mesh, sites, faces_to_consider, limits);
+}
+
+ClusterAndSites grow_sites_constrained(pmp::SurfaceMesh &mesh,
+                                       std::vector<Site> &sites,
+                                       std::vector<pmp::Face> &faces_to_consider,
+                                       MeshletLimits limits)
+{
+    assert(limits.max_vertices >= 3 && limits.max_triangles >= 1);
+
+    // create a face property to store the closest site
+    auto closest_site = reset_face_property(mesh, "f:closest_site");
+    // create a face property to store the iteration in which the face was added (here the ring distance to the site)
+    auto added_in_iteration = reset_face_property(mesh, "f:added_in_iteration");
+    // mark faces_to_consider in a dense mask
+    FaceMask faces_to_consider_mask(mesh, faces_to_consider);
+
+    // get face property indicating whether a face is a site (this is set in the site generation)
+    pmp::FaceProperty<bool> is_site = mesh.get_face_property<bool>("f:is_site");
+    assert(is_site);
+
+    // per face centroids and normals
+    auto geometry = get_geometry_cache(mesh);
+
+    // sites that saturate leave faces behind, these are covered by additional sites
+    ClusterAndSites cluster_and_sites;
+    auto &all_sites = cluster_and_sites.sites;
+    all_sites = sites;
+    // normalized site normals
+    std::vector<pmp::Normal> site_normals;
+    // distinct vertices and faces (without the site face) of the meshlet of each site
+    std::vector<std::vector<pmp::Vertex>> site_vertices;
+    std::vector<std::vector<pmp::Face>> site_members;
+
+    // faces reached by the sites, cheapest first
+    std::priority_queue<Candidate, std::vector<Candidate>,
+                        std::greater<Candidate>>
+        candidates;
+
+    // pushes the faces sharing an edge with the given face of the site (so the meshlets stay edge connected)
+    auto push_neighbors = [&](int site_id, pmp::Face face, int iteration) {
+        auto &site = all_sites[site_id];
+        for (auto f : get_adjacent_faces(mesh, face))
+        {
+            if (!faces_to_consider_mask[f] || is_site[f] ||
+                closest_site[f] != -1)
+            {
+                continue;
+            }
+            float cost =
+                normal_penalty(site_normals[site_id], geometry.normal(f)) *
+                pmp::distance(site.position, geometry.centroid(f));
+            candidates.push({cost, site_id, f.idx(), iteration});
+        }
+    };
+    // starts the meshlet of a site with its site face
+    auto seed_site = [&](const Site &site) {
+        site_normals.push_back(pmp::normalize(site.normal));
+        site_vertices.emplace_back();
+        for (auto v : mesh.vertices(site.face))
+        {
+            site_vertices.back().push_back(v);
+        }
+        site_members.emplace_back();
+        push_neighbors(site.id, site.face, 1);
+    };
+
+    for (size_t i = 0; i < all_sites.size(); i++)
+    {
+        assert(all_sites[i].id == static_cast<int>(i));
+        seed_site(all_sites[i]);
+    }
+
+    // faces rejected by a saturated site, they border finished meshlets and are used to seed new sites
+    std::deque<pmp::Face> rejected_faces;
+    size_t next_face = 0;
+    while (true)
+    {
+        while (!candidates.empty())
+        {
+            auto candidate = candidates.top();
+            candidates.pop();
+            pmp::Face face(candidate.face);
+            if (closest_site[face] != -1)
+            {
+                continue;
+            }
+
+            // only take the face if the meshlet stays within the limits
+            auto &vertices = site_vertices[candidate.site];
+            int new_vertices = 0;
+            for (auto v : mesh.vertices(face))
+            {
+                if (std::find(vertices.begin(), vertices.end(), v) ==
+                    vertices.end())
+                {
+                    new_vertices++;
+                }
+            }
+            auto &members = site_members[candidate.site];
+            // + 2 for the site face and the new face
+            if (static_cast<int>(members.size()) + 2 > limits.max_triangles ||
+                static_cast<int>(vertices.size()) + new_vertices >
+                    limits.max_vertices)
+            {
+                rejected_faces.push_back(face);
+                continue;
+            }
+
+            for (auto v : mesh.vertices(face))
+            {
+                if (std::find(vertices.begin(), vertices.end(), v) ==
+                    vertices.end())
+                {
+                    vertices.push_back(v);
+                }
+            }
+            members.push_back(face);
+            closest_site[face] = candidate.site;
+            added_in_iteration[face] = candidate.iteration;
+            push_neighbors(candidate.site, face, candidate.iteration + 1);
+        }
+
+        // start a new site at a face that no site could take
+        pmp::Face seed_face;
+        while (!rejected_faces.empty() && !seed_face.is_valid())
+        {
+            auto face = rejected_faces.front();
+            rejected_faces.pop_front();
+            if (closest_site[face] == -1 && !is_site[face])
+            {
+                seed_face = face;
+            }
+        }
+        while (!seed_face.is_valid() && next_face < faces_to_consider.size())
+        {
+            auto face = faces_to_consider[next_face++];
+            if (closest_site[face] == -1 && !is_site[face])
+            {
+                seed_face = face;
+            }
+        }
+        if (!seed_face.is_valid())
+        {
+            break;
+        }
+        is_site[seed_face] = true;
+        all_sites.emplace_back(static_cast<int>(all_sites.size()), seed_face,
+                               geometry.centroid(seed_face),
+                               geometry.normal(seed_face));
+        seed_site(all_sites.back());
+    }
+
+    // a meshlet is only valid if its site face is surrounded by its own faces (see is_valid),
+    // sites at the border of their meshlet are moved to the innermost such face
+    auto is_interior = [&](pmp::Face face, const Site &site) {
+        for (auto halfedge : mesh.halfedges(face))
+        {
+            auto opposite = mesh.opposite_halfedge(halfedge);
+            if (mesh.is_boundary(opposite))
+            {
+                return false;
+            }
+            auto neighbor = mesh.face(opposite);
+            if (neighbor != site.face && closest_site[neighbor] != site.id)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (auto &site : all_sites)
+    {
+        if (is_interior(site.face, site))
+        {
+            continue;
+        }
+        // members are stored in the order they were taken, so the first interior face is the innermost
+        auto &members = site_members[site.id];
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            auto face = members[i];
+            if (is_interior(face, site))
+            {
+                // the old site face becomes a member
+                members[i] = site.face;
+                is_site[site.face] = false;
+                closest_site[site.face] = site.id;
+                added_in_iteration[site.face] = 1;
+                is_site[face] = true;
+                closest_site[face] = -1;
+                added_in_iteration[face] = -1;
+                site.face = face;
+                site.position = geometry.centroid(face);
+                site.normal = geometry.normal(face);
+                break;
+            }
+        }
+    }
+
+    // a site that is still at the border of its meshlet leaves a small pocket between saturated meshlets, which is invalid.
+    // Such a meshlet moves its site to one of its faces and takes the missing faces around it from the adjacent meshlets,
+    // as long as it stays within the limits and the adjacent meshlets keep an interior site and stay edge connected
+    std::vector<bool> is_pocket(all_sites.size(), false);
+    for (auto &site : all_sites)
+    {
+        is_pocket[site.id] =
+            !site_members[site.id].empty() && !is_interior(site.face, site);
+    }
+    // a face can be given away if it is not next to the site face of its meshlet and the faces around the vertex
+    // opposite to the edges it shares with its meshlet belong to the meshlet, so the meshlet stays edge connected
+    auto can_give_away = [&](pmp::Face face) {
+        int owner = closest_site[face];
+        if (owner == -1 || is_pocket[owner] || !faces_to_consider_mask[face])
+        {
+            return false;
+        }
+        auto owner_face = all_sites[owner].face;
+        pmp::Halfedge outside;
+        int num_outside = 0;
+        for (auto halfedge : mesh.halfedges(face))
+        {
+            auto opposite = mesh.opposite_halfedge(halfedge);
+            if (mesh.is_boundary(opposite))
+            {
+                outside = halfedge;
+                num_outside++;
+                continue;
+            }
+            auto neighbor = mesh.face(opposite);
+            if (neighbor == owner_face)
+            {
+                return false;
+            }
+            if (closest_site[neighbor] != owner)
+            {
+                outside = halfedge;
+                num_outside++;
+            }
+        }
+        // with a single neighbor in the meshlet the face is at the end of a path
+        if (num_outside != 1)
+        {
+            return num_outside == 2;
+        }
+        // both other neighbors are in the meshlet, they stay connected around the vertex opposite to the outside edge
+        auto vertex = mesh.to_vertex(mesh.next_halfedge(outside));
+        if (mesh.is_boundary(vertex))
+        {
+            return false;
+        }
+        for (auto f : mesh.faces(vertex))
+        {
+            if (f != face && f != owner_face && closest_site[f] != owner)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    for (auto &site : all_sites)
+    {
+        if (!is_pocket[site.id])
+        {
+            continue;
+        }
+        auto &members = site_members[site.id];
+        for (size_t i = 0; i < members.size(); i++)
+        {
+            auto face = members[i];
+            // the faces around the new site face that belong to other meshlets
+            std::vector<pmp::Face> missing;
+            bool is_possible = true;
+            for (auto halfedge : mesh.halfedges(face))
+            {
+                auto opposite = mesh.opposite_halfedge(halfedge);
+                if (mesh.is_boundary(opposite))
+                {
+                    is_possible = false;
+                    break;
+                }
+                auto neighbor = mesh.face(opposite);
+                if (neighbor == site.face || closest_site[neighbor] == site.id)
+                {
+                    continue;
+                }
+                // faces of the same meshlet could disconnect it together
+                if (!can_give_away(neighbor) ||
+                    std::any_of(missing.begin(), missing.end(),
+                                [&](pmp::Face other) {
+                                    return closest_site[other] ==
+                                           closest_site[neighbor];
+                                }))
+                {
+                    is_possible = false;
+                    break;
+                }
+                missing.push_back(neighbor);
+            }
+            if (!is_possible)
+            {
+                continue;
+            }
+            // + 1 for the site face
+            auto vertices = site_vertices[site.id];
+            for (auto neighbor : missing)
+            {
+                for (auto v : mesh.vertices(neighbor))
+                {
+                    if (std::find(vertices.begin(), vertices.end(), v) ==
+                        vertices.end())
+                    {
+                        vertices.push_back(v);
+                    }
+                }
+            }
+            if (static_cast<int>(members.size() + missing.size()) + 1 >
+                    limits.max_triangles ||
+                static_cast<int>(vertices.size()) > limits.max_vertices)
+            {
+                continue;
+            }
+
+            // the vertices of the meshlets that give faces away are not updated, they only overestimate the meshlet size
+            for (auto neighbor : missing)
+            {
+                auto &owner_members = site_members[closest_site[neighbor]];
+                auto it = std::find(owner_members.begin(), owner_members.end(),
+                                    neighbor);
+                assert(it != owner_members.end());
+                owner_members.erase(it);
+                closest_site[neighbor] = site.id;
+                added_in_iteration[neighbor] = 1;
+                members.push_back(neighbor);
+            }
+            site_vertices[site.id] = vertices;
+            // move the site to the face, the old site face becomes a member
+            members[i] = site.face;
+            is_site[site.face] = false;
+            closest_site[site.face] = site.id;
+            added_in_iteration[site.face] = 1;
+            is_site[face] = true;
+            closest_site[face] = -1;
+            added_in_iteration[face] = -1;
+            site.face = face;
+            site.position = geometry.centroid(face);
+            site.normal = geometry.normal(face);
+            is_pocket[site.id] = false;
+            break;
+        }
+    }
+
+    // the remaining pockets are split into meshlets of a single face, which are always valid
+    size_t num_sites = all_sites.size();
+    for (size_t site_id = 0; site_id < num_sites; site_id++)
+    {
+        if (!is_pocket[site_id])
+        {
+            continue;
+        }
+        for (auto face : site_members[site_id])
+        {
+            is_site[face] = true;
+            closest_site[face] = -1;
+            added_in_iteration[face] = -1;
+            all_sites.emplace_back(static_cast<int>(all_sites.size()), face,
+                                   geometry.centroid(face),
+                                   geometry.normal(face));
+        }
+        site_members[site_id].clear();
+    }
+
+    // sort the faces into the meshlets of their closest site
+    std::vector<pmp::Face> site_faces(all_sites.size());
+    for (auto &site : all_sites)
+    {
+        site_faces[site.id] = site.face;
+    }
+    cluster_and_sites.cluster =
+        build_cluster(mesh, site_faces, faces_to_consider);
+    return cluster_and_sites;
+}
+} // namespace meshlets
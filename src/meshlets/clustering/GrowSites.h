@@ -26,4 +26,109 @@ Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
 Cluster grow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
                    std::vector<pmp::Face> &faces_to_consider,
                    int max_iterations = 1000);
+
+/**
+ * @brief update a grow sites clustering after some sites moved (e.g. between lloyd iterations).
+ * Only the meshlets of the moved sites and the meshlets sharing a vertex with them are grown again, all other faces keep their closest site.
+ * The result is close to, but not the same as, a new grow_sites clustering.
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites all sites, the moved sites at their new face (f:is_site has to be updated already)
+ * @param moved_sites the ids of the sites that moved since the cluster was computed
+ * @param cluster the previous cluster, computed by grow_sites (or regrow_sites) on the same faces
+ * @param faces_to_consider The faces to consider when performing the clustering
+ * @param max_iterations the maximum number of iterations the algorithm will perform (default: 1000)
+ * @return Cluster the resulting cluster
+*/
+Cluster regrow_sites(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                     const std::vector<int> &moved_sites,
+                     const Cluster &cluster,
+                     std::vector<pmp::Face> &faces_to_consider,
+                     int max_iterations = 1000);
+
+/**
+ * @brief perform a clustering by growing all sites in parallel. In every iteration the sites propose the faces around their growth front
+ * in parallel, afterwards every face goes to the proposal with the lowest penalized distance (ties go to the lower site id).
+ * In contrast to grow_sites the result does not depend on the order of the sites, so it is the same for any number of threads.
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to use for the clustering
+ * @param max_iterations the maximum number of iterations the algorithm will perform (default: 1000). The algorithm stops if the sites converge before the maximum number of iterations is reached.
+ * @param num_threads the number of threads to use (default: 1, 0: all hardware threads)
+ * @return Cluster the resulting cluster
+*/
+Cluster grow_sites_parallel(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            int max_iterations = 1000,
+                            unsigned int num_threads = 1);
+
+/**
+ * @brief perform a clustering by growing all sites in parallel (see grow_sites_parallel above)
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to use for the clustering
+ * @param faces_to_consider The faces to consider when performing the clustering
+ * @param max_iterations the maximum number of iterations the algorithm will perform (default: 1000). The algorithm stops if the sites converge before the maximum number of iterations is reached.
+ * @param num_threads the number of threads to use (default: 1, 0: all hardware threads)
+ * @return Cluster the resulting cluster
+*/
+Cluster grow_sites_parallel(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            std::vector<pmp::Face> &faces_to_consider,
+                            int max_iterations = 1000,
+                            unsigned int num_threads = 1);
+
+/**
+ * @brief perform a clustering by growing the sites in the global order of the penalized distance (Dijkstra-style).
+ * Faces reached by a site over an edge are kept in a bucketed queue of the quantized penalized distance and every face is assigned exactly
+ * once to the cheapest site that reaches it, so no faces are stolen between sites and there are no synchronous iterations.
+ * The order is exact up to the bucket width (half the mean edge length). The iteration of a face is the number of edges crossed from the site.
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to use for the clustering
+ * @param max_iterations the maximum number of edges crossed from the site to a face (default: 1000)
+ * @return Cluster the resulting cluster
+*/
+Cluster grow_sites_priority(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            int max_iterations = 1000);
+
+/**
+ * @brief perform a clustering by growing the sites in the global order of the penalized distance (see grow_sites_priority above)
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to use for the clustering
+ * @param faces_to_consider The faces to consider when performing the clustering
+ * @param max_iterations the maximum number of edges crossed from the site to a face (default: 1000)
+ * @return Cluster the resulting cluster
+*/
+Cluster grow_sites_priority(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
+                            std::vector<pmp::Face> &faces_to_consider,
+                            int max_iterations = 1000);
+
+/**
+ * @brief perform a clustering with hard meshlet size limits. The sites grow in the global order of the penalized distance (see grow_sites_priority)
+ * over edge adjacent faces, but a site only takes a face if its meshlet stays within the limits. Faces no site could take are covered by
+ * additional sites, which are seeded next to the saturated meshlets. Small pockets left between saturated meshlets take the faces around their site
+ * from the adjacent meshlets or are split into single face meshlets, so the resulting meshlets are valid (see is_valid) and never exceed the limits.
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to start the clustering with
+ * @param limits the maximum number of vertices and triangles per meshlet
+ * @return ClusterAndSites the resulting cluster and all sites, including the added ones (their faces are marked in f:is_site)
+*/
+ClusterAndSites grow_sites_constrained(pmp::SurfaceMesh &mesh,
+                                       std::vector<Site> &sites,
+                                       MeshletLimits limits = MeshletLimits());
+
+/**
+ * @brief perform a clustering with hard meshlet size limits (see grow_sites_constrained above)
+ * 
+ * @param mesh the mesh to calculate the cluster on
+ * @param sites the sites to start the clustering with
+ * @param faces_to_consider The faces to consider when performing the clustering
+ * @param limits the maximum number of vertices and triangles per meshlet
+ * @return ClusterAndSites the resulting cluster and all sites, including the added ones (their faces are marked in f:is_site)
+*/
+ClusterAndSites grow_sites_constrained(pmp::SurfaceMesh &mesh,
+                                       std::vector<Site> &sites,
+                                       std::vector<pmp::Face> &faces_to_consider,
+                                       MeshletLimits limits = MeshletLimits());
 } // namespace meshlets
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "KdTree.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace meshlets {
+KdTree::KdTree(const std::vector<Site> &sites)
+    : positions(sites.size()), site_indices(sites.size()),
+      split_axes(sites.size(), 0)
+{
+    // the build permutes the site indices, the positions are still in sites order
+    for (size_t i = 0; i < sites.size(); i++)
+    {
+        positions[i] = sites[i].position;
+    }
+    std::iota(site_indices.begin(), site_indices.end(), 0);
+    build(0, sites.size());
+
+    // bring the positions into tree order
+    std::vector<pmp::Point> tree_positions(sites.size());
+    for (size_t i = 0; i < sites.size(); i++)
+    {
+        tree_positions[i] = positions[site_indices[i]];
+    }
+    positions = std::move(tree_positions);
+}
+
+void KdTree::build(int begin, int end)
+{
+    if (end - begin <= leaf_size)
+    {
+        return;
+    }
+
+    // split along the axis with the largest extent
+    pmp::Point min = positions[site_indices[begin]];
+    pmp::Point max = min;
+    for (int i = begin + 1; i < end; i++)
+    {
+        min = pmp::min(min, positions[site_indices[i]]);
+        max = pmp::max(max, positions[site_indices[i]]);
+    }
+    auto extent = max - min;
+    unsigned char axis = 0;
+    if (extent[1] > extent[axis])
+        axis = 1;
+    if (extent[2] > extent[axis])
+        axis = 2;
+
+    int mid = begin + (end - begin) / 2;
+    std::nth_element(site_indices.begin() + begin, site_indices.begin() + mid,
+                     site_indices.begin() + end, [&](int lhs, int rhs) {
+                         return positions[lhs][axis] < positions[rhs][axis];
+                     });
+    split_axes[mid] = axis;
+
+    build(begin, mid);
+    build(mid + 1, end);
+}
+
+int KdTree::closest_site(const pmp::Point &point, float &min_distance) const
+{
+    int closest = -1;
+    min_distance = std::numeric_limits<float>::max();
+    search(point, 0, positions.size(), closest, min_distance);
+    return closest;
+}
+
+void KdTree::search(const pmp::Point &point, int begin, int end, int &closest,
+                    float &min_distance) const
+{
+    // the same distance and tie breaking as the linear search, so both return the same site
+    auto visit = [&](int i) {
+        float distance = pmp::distance(point, positions[i]);
+        if (distance < min_distance ||
+            (distance == min_distance && site_indices[i] < closest))
+        {
+            min_distance = distance;
+            closest = site_indices[i];
+        }
+    };
+
+    if (end - begin <= leaf_size)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            visit(i);
+        }
+        return;
+    }
+
+    int mid = begin + (end - begin) / 2;
+    visit(mid);
+
+    auto axis = split_axes[mid];
+    float plane_distance = point[axis] - positions[mid][axis];
+    if (plane_distance < 0)
+    {
+        search(point, begin, mid, closest, min_distance);
+        // a small slack keeps sites at the same (rounded) distance from being pruned
+        if (-plane_distance <= min_distance * (1.0f + 1e-5f))
+        {
+            search(point, mid + 1, end, closest, min_distance);
+        }
+    }
+    else
+    {
+        search(point, mid + 1, end, closest, min_distance);
+        if (plane_distance <= min_distance * (1.0f + 1e-5f))
+        {
+            search(point, begin, mid, closest, min_distance);
+        }
+    }
+}
+} // namespace meshlets
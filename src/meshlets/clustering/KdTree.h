@@ -0,0 +1,42 @@
+#pragma once
+
+#include "../Meshlets.h"
+
+namespace meshlets {
+/**
+ * @brief The KdTree data structure is a balanced kd-tree over the positions of a set of sites, used to find the closest site of a point without comparing it to every site.
+*/
+typedef struct KdTree
+{
+    /**
+     * @brief builds the tree
+     * 
+     * @param sites the sites to build the tree over (the tree does not reference them after construction)
+    */
+    KdTree(const std::vector<Site> &sites);
+
+    /**
+     * @brief finds the site closest to a point. If multiple sites have the same distance, the one that comes first in the sites vector is returned (same as a linear search).
+     * 
+     * @param point the point to find the closest site of
+     * @param min_distance is set to the distance to the closest site
+     * @return the index of the closest site in the sites vector (-1 if there are no sites)
+    */
+    int closest_site(const pmp::Point &point, float &min_distance) const;
+
+private:
+    // sites per leaf, leaves are searched linearly
+    static constexpr int leaf_size = 8;
+
+    // site positions in tree order
+    std::vector<pmp::Point> positions;
+    // index into the sites vector for each position
+    std::vector<int> site_indices;
+    // split axis of the inner node whose median is stored at that position
+    std::vector<unsigned char> split_axes;
+
+    void build(int begin, int end);
+    void search(const pmp::Point &point, int begin, int end, int &closest,
+                float &min_distance) const;
+} KdTree;
+} // namespace meshlets
@@ -1,24 +1,48 @@
 #include "Lloyd.h"
+#include "../GeometryCache.h"
+#include "../../helpers/ThreadPool.h"
 
-#include "pmp/algorithms/normals.h"
+#include <algorithm>
+#include <numeric>
 
 namespace meshlets {
 float median(std::vector<float> &values)
 {
-    std::sort(values.begin(), values.end());
-    return values[values.size() / 2];
+    // only the middle element has to be in place, which is linear instead of a full sort
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
 }
 
-pmp::Face find_closest_triangle(pmp::SurfaceMesh &mesh, Meshlet &meshlet,
-                                pmp::Point seed_point)
+pmp::Point area_weighted_mean(const GeometryCache &geometry, FaceRange faces)
+{
+    pmp::Point weighted_sum(0, 0, 0);
+    pmp::Point sum(0, 0, 0);
+    float total_area = 0.0f;
+    for (auto face : faces)
+    {
+        auto area = geometry.area[face.idx()];
+        auto centroid = geometry.centroid(face);
+        weighted_sum += area * centroid;
+        sum += centroid;
+        total_area += area;
+    }
+    // meshlets of degenerated faces fall back to the unweighted mean
+    if (total_area > 0.0f)
+    {
+        return weighted_sum / total_area;
+    }
+    return sum / static_cast<float>(faces.size());
+}
+
+pmp::Face find_closest_triangle(const GeometryCache &geometry,
+                                FaceRange faces, pmp::Point seed_point)
 {
-    auto faces = get_faces(meshlet);
     float min_distance = std::numeric_limits<float>::max();
     pmp::Face closest_face;
     for (auto &face : faces)
     {
-        auto centroid = pmp::centroid(mesh, face);
-        auto distance = pmp::distance(centroid, seed_point);
+        auto distance = pmp::sqrnorm(geometry.centroid(face) - seed_point);
         if (distance < min_distance)
         {
             min_distance = distance;
@@ -30,56 +54,81 @@ pmp::Face find_closest_triangle(pmp::SurfaceMesh &mesh, Meshlet &meshlet,
 
 std::vector<Site> generate_new_sites(pmp::SurfaceMesh &mesh,
                                      std::vector<Site> &old_sites,
-                                     Cluster &cluster)
+                                     Cluster &cluster, LloydCenter center,
+                                     unsigned int num_threads)
 {
     std::vector<Site> new_sites(old_sites.size());
     pmp::FaceProperty<bool> is_site = mesh.get_face_property<bool>("f:is_site");
     assert(is_site);
+    // compute the cache once up front, so the threads only read it
+    auto geometry = get_geometry_cache(mesh);
 
     // count how many meshlets changed their center triangle (relevant for stopping criterion)
-    int center_triangle_changed_count = 0;
-
-    for (auto &site : old_sites)
-    {
-        auto meshlet = cluster[site.id].get();
-
-        // create point cloud containing meshlet face centroids
-        std::vector<float> points_x;
-        std::vector<float> points_y;
-        std::vector<float> points_z;
-
-        for (auto face : get_faces(*meshlet))
-        {
-            auto centroid = pmp::centroid(mesh, face);
-            points_x.push_back(centroid[0]);
-            points_y.push_back(centroid[1]);
-            points_z.push_back(centroid[2]);
-        }
-
-        // compute median of point cloud
-        auto median_x = median(points_x);
-        auto median_y = median(points_y);
-        auto median_z = median(points_z);
-
-        pmp::Point meshlet_centroid = pmp::Point(median_x, median_y, median_z);
-        pmp::Face new_site_face =
-            find_closest_triangle(mesh, *meshlet, meshlet_centroid);
-
-        if (new_site_face != site.face)
-        {
-            auto normal = pmp::face_normal(mesh, new_site_face);
-            auto position = pmp::centroid(mesh, new_site_face);
-
-            new_sites[site.id] = Site(site.id, new_site_face, position, normal);
-            center_triangle_changed_count++;
-        }
-        else
-        {
-            new_sites[site.id] = site;
-        }
-    }
+    num_threads = helpers::resolve_num_threads(num_threads);
+    std::vector<size_t> center_triangle_changed_counts(num_threads, 0);
+
+    // the sites are independent, each chunk writes only the new sites of its own range
+    helpers::parallel_for(
+        old_sites.size(), num_threads,
+        [&](unsigned int chunk, size_t begin, size_t end) {
+            // point cloud containing meshlet face centroids (reused for all sites of the chunk)
+            std::vector<float> points_x;
+            std::vector<float> points_y;
+            std::vector<float> points_z;
+
+            for (size_t i = begin; i < end; i++)
+            {
+                auto &site = old_sites[i];
+                auto faces = get_faces(cluster[site.id]);
+
+                pmp::Point meshlet_centroid;
+                if (center == LloydCenter::AreaWeightedMean)
+                {
+                    meshlet_centroid = area_weighted_mean(geometry, faces);
+                }
+                else
+                {
+                    points_x.clear();
+                    points_y.clear();
+                    points_z.clear();
+                    for (auto face : faces)
+                    {
+                        auto idx = face.idx();
+                        points_x.push_back(geometry.centroid_x[idx]);
+                        points_y.push_back(geometry.centroid_y[idx]);
+                        points_z.push_back(geometry.centroid_z[idx]);
+                    }
+
+                    // compute median of point cloud
+                    auto median_x = median(points_x);
+                    auto median_y = median(points_y);
+                    auto median_z = median(points_z);
+
+                    meshlet_centroid = pmp::Point(median_x, median_y, median_z);
+                }
+                pmp::Face new_site_face =
+                    find_closest_triangle(geometry, faces, meshlet_centroid);
+
+                if (new_site_face != site.face)
+                {
+                    auto normal = geometry.normal(new_site_face);
+                    auto position = geometry.centroid(new_site_face);
+
+                    new_sites[site.id] =
+                        Site(site.id, new_site_face, position, normal);
+                    center_triangle_changed_counts[chunk]++;
+                }
+                else
+                {
+                    new_sites[site.id] = site;
+                }
+            }
+        });
 
     // stopping criterion
+    size_t center_triangle_changed_count =
+        std::accumulate(center_triangle_changed_counts.begin(),
+                        center_triangle_changed_counts.end(), size_t(0));
     if (center_triangle_changed_count < old_sites.size() * 0.01)
     {
         return std::vector<Site>();
@@ -99,42 +148,60 @@ std::vector<Site> generate_new_sites(pmp::SurfaceMesh &mesh,
 }
 
 ClusterAndSites lloyd(pmp::SurfaceMesh &mesh, std::vector<Site> &init_sites,
-                      int max_iterations)
+                      int max_iterations, LloydCenter center,
+                      bool warm_start, unsigned int num_threads)
 {
     std::vector<pmp::Face> faces_to_consider(mesh.faces_begin(),
                                              mesh.faces_end());
-    return lloyd(mesh, init_sites, faces_to_consider, max_iterations);
+    return lloyd(mesh, init_sites, faces_to_consider, max_iterations, center,
+                 warm_start, num_threads);
 }
 
 ClusterAndSites lloyd(pmp::SurfaceMesh &mesh, std::vector<Site> &init_sites,
                       std::vector<pmp::Face> &faces_to_consider,
-                      int max_iterations)
+                      int max_iterations, LloydCenter center,
+                      bool warm_start, unsigned int num_threads)
 {
     ClusterAndSites cluster_and_sites;
     cluster_and_sites.sites = init_sites;
+    cluster_and_sites.cluster =
+        grow_sites(mesh, cluster_and_sites.sites, faces_to_consider);
     int current_iteration = 0;
 
     while (current_iteration < max_iterations)
     {
-        // grow sites
-        cluster_and_sites.cluster =
-            grow_sites(mesh, cluster_and_sites.sites, faces_to_consider);
         // update sites and check for stopping criterion
-        auto new_sites = generate_new_sites(mesh, cluster_and_sites.sites,
-                                            cluster_and_sites.cluster);
+        auto new_sites =
+            generate_new_sites(mesh, cluster_and_sites.sites,
+                               cluster_and_sites.cluster, center, num_threads);
         if (new_sites.empty())
         {
             break;
         }
+
+        // grow sites
+        if (warm_start)
+        {
+            std::vector<int> moved_sites;
+            for (auto &site : new_sites)
+            {
+                if (site.face != cluster_and_sites.sites[site.id].face)
+                {
+                    moved_sites.push_back(site.id);
+                }
+            }
+            cluster_and_sites.cluster =
+                regrow_sites(mesh, new_sites, moved_sites,
+                             cluster_and_sites.cluster, faces_to_consider);
+        }
         else
         {
-            cluster_and_sites.sites = new_sites;
+            cluster_and_sites.cluster =
+                grow_sites(mesh, new_sites, faces_to_consider);
         }
+        cluster_and_sites.sites = new_sites;
         current_iteration++;
     }
-    // grow sites one last time
-    cluster_and_sites.cluster =
-        grow_sites(mesh, cluster_and_sites.sites, faces_to_consider);
     return cluster_and_sites;
 }
 } // namespace meshlets
\ No newline at end of file
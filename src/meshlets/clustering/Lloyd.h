@@ -5,16 +5,32 @@
 #include "pmp/algorithms/differential_geometry.h"
 
 namespace meshlets {
+/**
+ * @brief The LloydCenter enum selects the point a site is moved towards (the site moves to the meshlet face closest to it).
+*/
+enum class LloydCenter
+{
+    // per axis median of the face centroids
+    Median,
+    // mean of the face centroids weighted by the face areas
+    AreaWeightedMean
+};
+
 /**
  * @brief perform a clustering using the lloyd algorithm (i.e. perform repeated clustering while moving the sites to the center of their meshlet between each iteration)
  * 
  * @param mesh the mesh to calculate the cluster on
  * @param init_sites the initial sites to use for the first clustering iteration
  * @param max_iterations the maximum number of iterations the algorithm will perform (default: 100). The algorithm stops if almost nothing changes anymore before the maximum number of iterations is reached.
+ * @param center the point of each meshlet the site is moved towards (default: Median)
+ * @param warm_start if true, only the meshlets around the moved sites are grown again after the first iteration (see regrow_sites), so late iterations with few moved sites are cheap (default: false)
+ * @param num_threads the number of threads the site update is split across (default: 1, 0: all hardware threads), the result does not depend on it
  * @return ClusterAndSites the resulting cluster and sites
 */
 ClusterAndSites lloyd(pmp::SurfaceMesh &mesh, std::vector<Site> &init_sites,
-                      int max_iterations = 100);
+                      int max_iterations = 100,
+                      LloydCenter center = LloydCenter::Median,
+                      bool warm_start = false, unsigned int num_threads = 1);
 
 /**
  * @brief perform a clustering using the lloyd algorithm (i.e. perform repeated clustering while moving the sites to the center of their meshlet between each iteration)
@@ -23,9 +39,14 @@ ClusterAndSites lloyd(pmp::SurfaceMesh &mesh, std::vector<Site> &init_sites,
  * @param init_sites the initial sites to use for the first clustering iteration
  * @param faces_to_consider the faces to consider for the clustering
  * @param max_iterations the maximum number of iterations the algorithm will perform (default: 100). The algorithm stops if almost nothing changes anymore before the maximum number of iterations is reached.
+ * @param center the point of each meshlet the site is moved towards (default: Median)
+ * @param warm_start if true, only the meshlets around the moved sites are grown again after the first iteration (see regrow_sites), so late iterations with few moved sites are cheap (default: false)
+ * @param num_threads the number of threads the site update is split across (default: 1, 0: all hardware threads), the result does not depend on it
  * @return ClusterAndSites the resulting cluster and sites
 */
 ClusterAndSites lloyd(pmp::SurfaceMesh &mesh, std::vector<Site> &init_sites,
                       std::vector<pmp::Face> &faces_to_consider,
-                      int max_iterations = 100);
+                      int max_iterations = 100,
+                      LloydCenter center = LloydCenter::Median,
+                      bool warm_start = false, unsigned int num_threads = 1);
 } // namespace meshlets
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "SitePositions.h"
+
+#include <limits>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MESHLETS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace meshlets {
+namespace {
+typedef int (*ClosestSiteKernel)(const float *x, const float *y,
+                                 const float *z, int num_padded,
+                                 const pmp::Point &point,
+                                 float &min_squared_distance);
+
+int closest_site_scalar(const float *x, const float *y, const float *z,
+                        int num_padded, const pmp::Point &point,
+                        float &min_squared_distance)
+{
+    int closest = -1;
+    min_squared_distance = std::numeric_limits<float>::max();
+    for (int i = 0; i < num_padded; i++)
+    {
+        float dx = x[i] - point[0];
+        float dy = y[i] - point[1];
+        float dz = z[i] - point[2];
+        float squared_distance = dx * dx + dy * dy + dz * dz;
+        if (squared_distance < min_squared_distance)
+        {
+            min_squared_distance = squared_distance;
+            closest = i;
+        }
+    }
+    return closest;
+}
+
+#ifdef MESHLETS_X86_SIMD
+// picks the lane with the smallest distance, on ties the lowest site index
+int reduce_lanes(const float *distances, const int *indices, int num_lanes,
+                 float &min_squared_distance)
+{
+    int closest = -1;
+    min_squared_distance = std::numeric_limits<float>::max();
+    for (int lane = 0; lane < num_lanes; lane++)
+    {
+        if (indices[lane] == -1)
+        {
+            continue;
+        }
+        if (distances[lane] < min_squared_distance ||
+            (distances[lane] == min_squared_distance &&
+             indices[lane] < closest))
+        {
+            min_squared_distance = distances[lane];
+            closest = indices[lane];
+        }
+    }
+    return closest;
+}
+
+// SSE2 is part of x86-64, so this kernel needs no runtime check
+int closest_site_sse2(const float *x, const float *y, const float *z,
+                      int num_padded, const pmp::Point &point,
+                      float &min_squared_distance)
+{
+    const __m128 px = _mm_set1_ps(point[0]);
+    const __m128 py = _mm_set1_ps(point[1]);
+    const __m128 pz = _mm_set1_ps(point[2]);
+    __m128 best = _mm_set1_ps(std::numeric_limits<float>::max());
+    __m128i best_index = _mm_set1_epi32(-1);
+    __m128i index = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i step = _mm_set1_epi32(4);
+
+    for (int i = 0; i < num_padded; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), px);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), py);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), pz);
+        __m128 squared_distance =
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                       _mm_mul_ps(dz, dz));
+        // strictly smaller keeps the first site per lane on ties
+        __m128 closer = _mm_cmplt_ps(squared_distance, best);
+        best = _mm_or_ps(_mm_and_ps(closer, squared_distance),
+                         _mm_andnot_ps(closer, best));
+        __m128i closer_int = _mm_castps_si128(closer);
+        best_index = _mm_or_si128(_mm_and_si128(closer_int, index),
+                                  _mm_andnot_si128(closer_int, best_index));
+        index = _mm_add_epi32(index, step);
+    }
+
+    alignas(16) float distances[4];
+    alignas(16) int indices[4];
+    _mm_store_ps(distances, best);
+    _mm_store_si128(reinterpret_cast<__m128i *>(indices), best_index);
+    return reduce_lanes(distances, indices, 4, min_squared_distance);
+}
+
+__attribute__((target("avx2"))) int closest_site_avx2(
+    const float *x, const float *y, const float *z, int num_padded,
+    const pmp::Point &point, float &min_squared_distance)
+{
+    const __m256 px = _mm256_set1_ps(point[0]);
+    const __m256 py = _mm256_set1_ps(point[1]);
+    const __m256 pz = _mm256_set1_ps(point[2]);
+    __m256 best = _mm256_set1_ps(std::numeric_limits<float>::max());
+    __m256i best_index = _mm256_set1_epi32(-1);
+    __m256i index = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i step = _mm256_set1_epi32(8);
+
+    for (int i = 0; i < num_padded; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), px);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), py);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), pz);
+        __m256 squared_distance = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+            _mm256_mul_ps(dz, dz));
+        // strictly smaller keeps the first site per lane on ties
+        __m256 closer = _mm256_cmp_ps(squared_distance, best, _CMP_LT_OQ);
+        best = _mm256_blendv_ps(best, squared_distance, closer);
+        best_index = _mm256_castps_si256(
+            _mm256_blendv_ps(_mm256_castsi256_ps(best_index),
+                             _mm256_castsi256_ps(index), closer));
+        index = _mm256_add_epi32(index, step);
+    }
+
+    alignas(32) float distances[8];
+    alignas(32) int indices[8];
+    _mm256_store_ps(distances, best);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(indices), best_index);
+    return reduce_lanes(distances, indices, 8, min_squared_distance);
+}
+#endif
+
+struct Kernel
+{
+    ClosestSiteKernel function;
+    const char *name;
+};
+
+// the fastest kernel supported by the CPU
+Kernel detect_kernel()
+{
+#ifdef MESHLETS_X86_SIMD
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return Kernel{closest_site_avx2, "AVX2"};
+    }
+    return Kernel{closest_site_sse2, "SSE2"};
+#else
+    return Kernel{closest_site_scalar, "scalar"};
+#endif
+}
+
+Kernel &select_kernel()
+{
+    static Kernel kernel = detect_kernel();
+    return kernel;
+}
+} // namespace
+
+SitePositions::SitePositions(const std::vector<Site> &sites)
+{
+    // pad to a multiple of 8 with positions that are never the closest
+    size_t num_padded = (sites.size() + 7) / 8 * 8;
+    x.assign(num_padded, std::numeric_limits<float>::infinity());
+    y.assign(num_padded, std::numeric_limits<float>::infinity());
+    z.assign(num_padded, std::numeric_limits<float>::infinity());
+    for (size_t i = 0; i < sites.size(); i++)
+    {
+        x[i] = sites[i].position[0];
+        y[i] = sites[i].position[1];
+        z[i] = sites[i].position[2];
+    }
+}
+
+int SitePositions::closest_site(const pmp::Point &point,
+                                float &min_squared_distance) const
+{
+    return select_kernel().function(x.data(), y.data(), z.data(), x.size(),
+                                    point, min_squared_distance);
+}
+
+const char *SitePositions::kernel_name()
+{
+    return select_kernel().name;
+}
+
+bool SitePositions::set_kernel(const std::string &name)
+{
+    if (name == "auto")
+    {
+        select_kernel() = detect_kernel();
+        return true;
+    }
+    if (name == "scalar")
+    {
+        select_kernel() = Kernel{closest_site_scalar, "scalar"};
+        return true;
+    }
+#ifdef MESHLETS_X86_SIMD
+    if (name == "sse2")
+    {
+        select_kernel() = Kernel{closest_site_sse2, "SSE2"};
+        return true;
+    }
+    if (name == "avx2" && __builtin_cpu_supports("avx2"))
+    {
+        select_kernel() = Kernel{closest_site_avx2, "AVX2"};
+        return true;
+    }
+#endif
+    return false;
+}
+} // namespace meshlets
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../Meshlets.h"
+
+namespace meshlets {
+/**
+ * @brief The SitePositions data structure stores the positions of a set of sites as structure of arrays, so the closest site of a point can be found with SIMD instructions.
+ * The kernel (AVX2, SSE2 or scalar) is selected at runtime depending on the features of the CPU, it can be overridden with set_kernel.
+*/
+typedef struct SitePositions
+{
+    SitePositions(const std::vector<Site> &sites);
+
+    /**
+     * @brief finds the site closest to a point by comparing squared distances to all sites. If multiple sites have the same squared distance, the one that comes first in the sites vector is returned.
+     * 
+     * @param point the point to find the closest site of
+     * @param min_squared_distance is set to the squared distance to the closest site
+     * @return the index of the closest site in the sites vector (-1 if there are no sites)
+    */
+    int closest_site(const pmp::Point &point,
+                     float &min_squared_distance) const;
+
+    /**
+     * @brief name of the kernel used on this CPU ("AVX2", "SSE2" or "scalar")
+    */
+    static const char *kernel_name();
+
+    /**
+     * @brief overrides the kernel used by all SitePositions (not thread safe, call it before clustering)
+     * 
+     * @param name "auto" (fastest supported kernel), "avx2", "sse2" or "scalar"
+     * @return false if the kernel is unknown or not supported by this CPU (the kernel is not changed then)
+    */
+    static bool set_kernel(const std::string &name);
+
+private:
+    // the arrays are padded to a multiple of 8 with infinitely far away positions
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+} SitePositions;
+} // namespace meshlets
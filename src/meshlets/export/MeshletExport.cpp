@@ -0,0 +1,171 @@
+#include "MeshletExport.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace meshlets {
+namespace {
+const uint32_t meshlet_file_magic = 0x4c48534d; // "MSHL"
+const uint32_t meshlet_file_version = 2;
+
+// appends the bytes of a vector to the buffer
+template <typename T>
+void append(std::vector<char> &buffer, const std::vector<T> &data)
+{
+    size_t offset = buffer.size();
+    buffer.resize(offset + data.size() * sizeof(T));
+    if (!data.empty())
+    {
+        std::memcpy(buffer.data() + offset, data.data(),
+                    data.size() * sizeof(T));
+    }
+}
+} // namespace
+
+void build_meshlet_buffers(pmp::SurfaceMesh &mesh, Cluster &cluster,
+                           MeshletBuffers &buffers, unsigned int num_threads,
+                           MeshletLimits limits)
+{
+    assert(limits.max_vertices >= 3 && limits.max_vertices <= 256 &&
+           limits.max_triangles >= 1);
+
+    buffers = MeshletBuffers();
+    buffers.meshlets.reserve(cluster.size());
+    buffers.meshlet_triangles.reserve(cluster.faces.size() * 3 +
+                                      cluster.size() * 3);
+    // faces of each exported meshlet (a chunk of a cluster meshlet), used for the bounds
+    std::vector<FaceRange> face_ranges;
+    face_ranges.reserve(cluster.size());
+
+    // local index of each mesh vertex in the current meshlet (-1 if not used yet)
+    std::vector<int> local_index(mesh.vertices_size(), -1);
+    MeshletDescriptor descriptor;
+    // starts a new exported meshlet at the end of the buffers
+    auto begin_meshlet = [&]() {
+        descriptor.vertex_offset = buffers.meshlet_vertices.size();
+        descriptor.triangle_offset = buffers.meshlet_triangles.size();
+        descriptor.vertex_count = 0;
+        descriptor.triangle_count = 0;
+    };
+    // stores the descriptor of the current meshlet
+    auto end_meshlet = [&]() {
+        // pad the triangles of each meshlet to 4 bytes
+        buffers.meshlet_triangles.resize(
+            (buffers.meshlet_triangles.size() + 3) & ~size_t(3), 0);
+
+        // reset the local indices for the next meshlet
+        for (uint32_t i = 0; i < descriptor.vertex_count; i++)
+        {
+            local_index[buffers.meshlet_vertices[descriptor.vertex_offset + i]] =
+                -1;
+        }
+        buffers.meshlets.push_back(descriptor);
+    };
+
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
+    {
+        auto faces = cluster[meshlet_id].faces();
+        auto chunk_begin = faces.begin();
+        begin_meshlet();
+        for (auto it = faces.begin(); it != faces.end(); ++it)
+        {
+            int new_vertices = 0;
+            for (auto vertex : mesh.vertices(*it))
+            {
+                if (local_index[vertex.idx()] == -1)
+                {
+                    new_vertices++;
+                }
+            }
+            // continue in a new meshlet if the face does not fit into the current one
+            if (descriptor.triangle_count > 0 &&
+                (static_cast<int>(descriptor.vertex_count) + new_vertices >
+                     limits.max_vertices ||
+                 static_cast<int>(descriptor.triangle_count) + 1 >
+                     limits.max_triangles))
+            {
+                end_meshlet();
+                face_ranges.emplace_back(chunk_begin, it);
+                chunk_begin = it;
+                begin_meshlet();
+            }
+
+            for (auto vertex : mesh.vertices(*it))
+            {
+                if (local_index[vertex.idx()] == -1)
+                {
+                    local_index[vertex.idx()] = descriptor.vertex_count++;
+                    buffers.meshlet_vertices.push_back(vertex.idx());
+                }
+                buffers.meshlet_triangles.push_back(local_index[vertex.idx()]);
+            }
+            descriptor.triangle_count++;
+        }
+        end_meshlet();
+        face_ranges.emplace_back(chunk_begin, faces.end());
+    }
+
+    buffers.bounds = compute_bounds(mesh, face_ranges, num_threads);
+
+    buffers.vertex_positions.resize(mesh.vertices_size() * 3);
+    auto positions = mesh.get_vertex_property<pmp::Point>("v:point");
+    for (size_t i = 0; i < mesh.vertices_size(); i++)
+    {
+        auto &position = positions[pmp::Vertex(i)];
+        buffers.vertex_positions[i * 3 + 0] = position[0];
+        buffers.vertex_positions[i * 3 + 1] = position[1];
+        buffers.vertex_positions[i * 3 + 2] = position[2];
+    }
+}
+
+bool write_meshlet_buffers(const MeshletBuffers &buffers,
+                           const std::string &file)
+{
+    std::vector<uint32_t> header = {
+        meshlet_file_magic,
+        meshlet_file_version,
+        static_cast<uint32_t>(buffers.meshlets.size()),
+        static_cast<uint32_t>(buffers.vertex_positions.size() / 3),
+        static_cast<uint32_t>(buffers.meshlet_vertices.size()),
+        static_cast<uint32_t>(buffers.meshlet_triangles.size()),
+        0,
+        0};
+
+    // four vec4 aligned floats per meshlet
+    std::vector<float> bounds;
+    bounds.reserve(buffers.bounds.size() * 12);
+    for (auto &meshlet_bounds : buffers.bounds)
+    {
+        bounds.insert(bounds.end(),
+                      {meshlet_bounds.center[0], meshlet_bounds.center[1],
+                       meshlet_bounds.center[2], meshlet_bounds.radius,
+                       meshlet_bounds.cone_apex[0], meshlet_bounds.cone_apex[1],
+                       meshlet_bounds.cone_apex[2], meshlet_bounds.cone_cutoff,
+                       meshlet_bounds.cone_axis[0], meshlet_bounds.cone_axis[1],
+                       meshlet_bounds.cone_axis[2], 0.0f});
+    }
+
+    // assemble the file in memory, so it is written with a single call
+    std::vector<char> buffer;
+    buffer.reserve(header.size() * sizeof(uint32_t) +
+                   buffers.vertex_positions.size() * sizeof(float) +
+                   buffers.meshlets.size() * sizeof(MeshletDescriptor) +
+                   bounds.size() * sizeof(float) +
+                   buffers.meshlet_vertices.size() * sizeof(uint32_t) +
+                   buffers.meshlet_triangles.size());
+    append(buffer, header);
+    append(buffer, buffers.vertex_positions);
+    append(buffer, buffers.meshlets);
+    append(buffer, bounds);
+    append(buffer, buffers.meshlet_vertices);
+    append(buffer, buffers.meshlet_triangles);
+
+    std::ofstream out(file, std::ios::binary);
+    if (!out)
+    {
+        return false;
+    }
+    out.write(buffer.data(), buffer.size());
+    return out.good();
+}
+} // namespace meshlets
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../Meshlets.h"
+#include "../MeshletBounds.h"
+
+#include <cstdint>
+#include <string>
+
+namespace meshlets {
+/**
+ * @brief The MeshletDescriptor data structure describes one meshlet in the exported buffers (the layout matches the file).
+*/
+typedef struct MeshletDescriptor
+{
+    // offset of the first local vertex in meshlet_vertices
+    uint32_t vertex_offset;
+    // offset of the first triangle in meshlet_triangles (in bytes, aligned to 4)
+    uint32_t triangle_offset;
+    // number of local vertices
+    uint32_t vertex_count;
+    // number of triangles
+    uint32_t triangle_count;
+} MeshletDescriptor;
+
+/**
+ * @brief The MeshletBuffers data structure holds a cluster in a GPU-ready form.
+ * Each meshlet has a list of local vertices (indices into the mesh vertices) and its triangles as three 8-bit local vertex indices.
+*/
+typedef struct MeshletBuffers
+{
+    std::vector<MeshletDescriptor> meshlets;
+    // culling data of each meshlet
+    std::vector<MeshletBounds> bounds;
+    // mesh vertex index of each local vertex of all meshlets
+    std::vector<uint32_t> meshlet_vertices;
+    // three local vertex indices per triangle, the triangles of each meshlet are padded to 4 bytes
+    std::vector<uint8_t> meshlet_triangles;
+    // positions of the mesh vertices (x, y, z per vertex)
+    std::vector<float> vertex_positions;
+} MeshletBuffers;
+
+/**
+ * @brief builds the GPU-ready buffers of a cluster including the meshlet bounds. The local vertices of a meshlet are ordered by their first use.
+ * A meshlet that exceeds the limits is split into chunks of consecutive faces (in the order of its iterations),
+ * every chunk is exported as a meshlet with its own descriptor and bounds.
+ * 
+ * @param mesh the mesh the cluster is located on
+ * @param cluster the cluster to export
+ * @param buffers the resulting buffers
+ * @param num_threads the number of threads used for the bounds (default: 1, 0: all hardware threads)
+ * @param limits the maximum number of vertices (at most 256, so they can be addressed with 8 bits) and triangles of an exported meshlet (default: 256 each)
+*/
+void build_meshlet_buffers(pmp::SurfaceMesh &mesh, Cluster &cluster,
+                           MeshletBuffers &buffers,
+                           unsigned int num_threads = 1,
+                           MeshletLimits limits = {256, 256});
+
+/**
+ * @brief writes the buffers as one contiguous little-endian binary file:
+ * a header of 8 uint32 (magic "MSHL", version, meshlet count, vertex count, meshlet vertex count, meshlet triangle bytes, reserved, reserved)
+ * followed by the vertex positions, the meshlet descriptors, the meshlet bounds, the meshlet vertices and the meshlet triangles.
+ * The bounds of a meshlet are 12 floats: center (xyz), radius, cone apex (xyz), cone cutoff, cone axis (xyz), 0.
+ * 
+ * @param buffers the buffers to write
+ * @param file the file to write to
+ * @return true if the file was written
+*/
+bool write_meshlet_buffers(const MeshletBuffers &buffers,
+                           const std::string &file);
+} // namespace meshlets
@@ -0,0 +1,251 @@
+#include "MeshletOptimization.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace meshlets {
+namespace {
+// Tipsify (Sander et al. 2007) on the local indices of one meshlet, returns the new order of the triangles
+std::vector<uint32_t> tipsify(const uint8_t *triangles, uint32_t triangle_count,
+                              uint32_t vertex_count, int cache_size)
+{
+    // triangles around each vertex
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (uint32_t i = 0; i < triangle_count * 3; i++)
+    {
+        offsets[triangles[i] + 1]++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<uint32_t> adjacency(triangle_count * 3);
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t i = 0; i < triangle_count * 3; i++)
+    {
+        adjacency[fill[triangles[i]]++] = i / 3;
+    }
+
+    // number of triangles around each vertex that are not emitted yet
+    std::vector<int> live(vertex_count);
+    for (uint32_t v = 0; v < vertex_count; v++)
+    {
+        live[v] = offsets[v + 1] - offsets[v];
+    }
+    std::vector<int> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> order;
+    order.reserve(triangle_count);
+
+    int time = cache_size + 1;
+    uint32_t cursor = 0;
+    int vertex = vertex_count > 0 ? 0 : -1;
+    while (vertex >= 0)
+    {
+        // emit all open triangles around the vertex
+        candidates.clear();
+        for (uint32_t i = offsets[vertex]; i < offsets[vertex + 1]; i++)
+        {
+            uint32_t triangle = adjacency[i];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = true;
+            order.push_back(triangle);
+            for (int k = 0; k < 3; k++)
+            {
+                uint8_t v = triangles[triangle * 3 + k];
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cache_time[v] > cache_size)
+                {
+                    cache_time[v] = time++;
+                }
+            }
+        }
+
+        // continue with the candidate that stays in the cache the longest
+        int next = -1;
+        int best_priority = -1;
+        for (auto v : candidates)
+        {
+            if (live[v] <= 0)
+            {
+                continue;
+            }
+            int priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size)
+            {
+                priority = time - cache_time[v];
+            }
+            if (priority > best_priority)
+            {
+                best_priority = priority;
+                next = v;
+            }
+        }
+        // dead end: take a recently used vertex with open triangles, otherwise the next one in index order
+        while (next == -1 && !dead_end.empty())
+        {
+            uint32_t v = dead_end.back();
+            dead_end.pop_back();
+            if (live[v] > 0)
+            {
+                next = v;
+            }
+        }
+        while (next == -1 && cursor < vertex_count)
+        {
+            if (live[cursor] > 0)
+            {
+                next = cursor;
+            }
+            cursor++;
+        }
+        vertex = next;
+    }
+    return order;
+}
+
+// spreads the lower 10 bits of x so that there are two zero bits between each bit
+uint32_t spread_bits(uint32_t x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x30000ff;
+    x = (x | (x << 8)) & 0x300f00f;
+    x = (x | (x << 4)) & 0x30c30c3;
+    x = (x | (x << 2)) & 0x9249249;
+    return x;
+}
+} // namespace
+
+void optimize_meshlet_buffers(MeshletBuffers &buffers, int cache_size)
+{
+    size_t num_meshlets = buffers.meshlets.size();
+
+    // order the meshlets along a Morton curve through the centers of their bounding spheres
+    std::vector<size_t> meshlet_order(num_meshlets);
+    std::iota(meshlet_order.begin(), meshlet_order.end(), 0);
+    if (buffers.bounds.size() == num_meshlets && num_meshlets > 0)
+    {
+        pmp::Point min(std::numeric_limits<float>::max());
+        pmp::Point max(-std::numeric_limits<float>::max());
+        for (auto &bounds : buffers.bounds)
+        {
+            min = pmp::min(min, bounds.center);
+            max = pmp::max(max, bounds.center);
+        }
+        std::vector<uint32_t> codes(num_meshlets);
+        for (size_t i = 0; i < num_meshlets; i++)
+        {
+            uint32_t code = 0;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float extent = max[axis] - min[axis];
+                float t = extent > 0.0f
+                              ? (buffers.bounds[i].center[axis] - min[axis]) /
+                                    extent
+                              : 0.0f;
+                code |= spread_bits(static_cast<uint32_t>(t * 1023.0f + 0.5f))
+                        << axis;
+            }
+            codes[i] = code;
+        }
+        std::stable_sort(
+            meshlet_order.begin(), meshlet_order.end(),
+            [&](size_t a, size_t b) { return codes[a] < codes[b]; });
+    }
+
+    MeshletBuffers optimized;
+    optimized.vertex_positions = std::move(buffers.vertex_positions);
+    optimized.meshlets.reserve(num_meshlets);
+    optimized.bounds.reserve(buffers.bounds.size());
+    optimized.meshlet_vertices.reserve(buffers.meshlet_vertices.size());
+    optimized.meshlet_triangles.reserve(buffers.meshlet_triangles.size());
+
+    std::vector<int> new_index;
+    for (auto meshlet_id : meshlet_order)
+    {
+        auto &meshlet = buffers.meshlets[meshlet_id];
+        const uint8_t *triangles =
+            buffers.meshlet_triangles.data() + meshlet.triangle_offset;
+        auto triangle_order = tipsify(triangles, meshlet.triangle_count,
+                                      meshlet.vertex_count, cache_size);
+
+        MeshletDescriptor descriptor;
+        descriptor.vertex_offset = optimized.meshlet_vertices.size();
+        descriptor.triangle_offset = optimized.meshlet_triangles.size();
+        descriptor.vertex_count = meshlet.vertex_count;
+        descriptor.triangle_count = meshlet.triangle_count;
+
+        // renumber the local vertices in the order of their first use
+        new_index.assign(meshlet.vertex_count, -1);
+        int num_used = 0;
+        for (auto triangle : triangle_order)
+        {
+            for (int k = 0; k < 3; k++)
+            {
+                uint8_t v = triangles[triangle * 3 + k];
+                if (new_index[v] == -1)
+                {
+                    new_index[v] = num_used++;
+                    optimized.meshlet_vertices.push_back(
+                        buffers.meshlet_vertices[meshlet.vertex_offset + v]);
+                }
+                optimized.meshlet_triangles.push_back(new_index[v]);
+            }
+        }
+        optimized.meshlet_triangles.resize(
+            (optimized.meshlet_triangles.size() + 3) & ~size_t(3), 0);
+
+        optimized.meshlets.push_back(descriptor);
+        if (meshlet_id < buffers.bounds.size())
+        {
+            optimized.bounds.push_back(buffers.bounds[meshlet_id]);
+        }
+    }
+    buffers = std::move(optimized);
+}
+
+MeshletStatistics analyze_meshlet_buffers(const MeshletBuffers &buffers,
+                                          int cache_size)
+{
+    MeshletStatistics statistics;
+    statistics.acmr = 0.0f;
+    statistics.vertices_per_triangle = 0.0f;
+
+    // FIFO vertex cache over the mesh vertex indices of all meshlets in order
+    std::vector<uint32_t> cache(cache_size, std::numeric_limits<uint32_t>::max());
+    size_t cache_head = 0;
+    size_t misses = 0;
+    size_t num_triangles = 0;
+    size_t num_vertices = 0;
+    for (auto &meshlet : buffers.meshlets)
+    {
+        for (uint32_t i = 0; i < meshlet.triangle_count * 3; i++)
+        {
+            uint32_t vertex =
+                buffers.meshlet_vertices
+                    [meshlet.vertex_offset +
+                     buffers.meshlet_triangles[meshlet.triangle_offset + i]];
+            if (std::find(cache.begin(), cache.end(), vertex) == cache.end())
+            {
+                cache[cache_head] = vertex;
+                cache_head = (cache_head + 1) % cache.size();
+                misses++;
+            }
+        }
+        num_triangles += meshlet.triangle_count;
+        num_vertices += meshlet.vertex_count;
+    }
+    if (num_triangles > 0)
+    {
+        statistics.acmr = static_cast<float>(misses) / num_triangles;
+        statistics.vertices_per_triangle =
+            static_cast<float>(num_vertices) / num_triangles;
+    }
+    return statistics;
+}
+} // namespace meshlets
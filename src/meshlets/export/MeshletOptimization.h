@@ -0,0 +1,35 @@
+#pragma once
+
+#include "MeshletExport.h"
+
+namespace meshlets {
+/**
+ * @brief The MeshletStatistics data structure holds measures of the vertex reuse of exported meshlets.
+*/
+typedef struct MeshletStatistics
+{
+    // average cache miss ratio: vertex cache misses per triangle of a simulated FIFO cache over all meshlets
+    float acmr;
+    // local vertices per triangle (the number of vertices a mesh shader has to transform per triangle)
+    float vertices_per_triangle;
+} MeshletStatistics;
+
+/**
+ * @brief reorders the triangles inside each meshlet for vertex reuse (Tipsify) and renumbers the local vertices in the order of their first use.
+ * Afterwards the meshlets are sorted along a Morton (Z-order) curve through the centers of their bounding spheres,
+ * so meshlets that are close in space are close in memory. The meshlet order then no longer matches the cluster.
+ * 
+ * @param buffers the buffers to reorder
+ * @param cache_size the size of the vertex cache the triangles are ordered for (default: 16)
+*/
+void optimize_meshlet_buffers(MeshletBuffers &buffers, int cache_size = 16);
+
+/**
+ * @brief measures the vertex reuse of exported meshlets
+ * 
+ * @param buffers the buffers to measure
+ * @param cache_size the size of the simulated FIFO vertex cache (default: 16)
+*/
+MeshletStatistics analyze_meshlet_buffers(const MeshletBuffers &buffers,
+                                          int cache_size = 16);
+} // namespace meshlets
@@ -1,4 +1,5 @@
 #include "PoissonDiskRandom.h"
+#include "../GeometryCache.h"
 
 namespace meshlets {
 bool is_valid_site(pmp::SurfaceMesh &mesh, std::vector<Site> &sites,
@@ -36,17 +37,19 @@ std::vector<Site> generate_pds_sites(pmp::SurfaceMesh &mesh, int amount)
         }
     }
 
+    auto geometry = get_geometry_cache(mesh);
+
     while (selected < amount)
     {
         auto face = helpers::pick_random_face(mesh);
         // calculate center of face
-        pmp::vec3 centroid = pmp::centroid(mesh, face);
+        pmp::vec3 centroid = geometry.centroid(face);
 
         if (is_valid_site(mesh, sites, centroid))
         {
             is_site[face] = true;
             // get normal of face
-            pmp::vec3 normal = pmp::face_normal(mesh, face);
+            pmp::vec3 normal = geometry.normal(face);
             sites[selected] = Site(selected, face, centroid, normal);
             selected++;
         }
@@ -1,4 +1,5 @@
 #include "RandomSites.h"
+#include "../GeometryCache.h"
 
 namespace meshlets {
 std::vector<Site> generate_random_sites(pmp::SurfaceMesh &mesh, int amount)
@@ -30,6 +31,8 @@ std::vector<Site> generate_random_sites(
         }
     }
 
+    auto geometry = get_geometry_cache(mesh);
+
     while (selected < amount)
     {
         auto face = helpers::pick_random_face(mesh, faces_to_consider);
@@ -39,9 +42,9 @@ std::vector<Site> generate_random_sites(
         }
         is_site[face] = true;
         // calculate center of face
-        pmp::vec3 centroid = pmp::centroid(mesh, face);
+        pmp::vec3 centroid = geometry.centroid(face);
         // get normal of face
-        pmp::vec3 normal = pmp::face_normal(mesh, face);
+        pmp::vec3 normal = geometry.normal(face);
         sites[selected] = Site(selected, face, centroid, normal);
         selected++;
     }
@@ -30,9 +30,9 @@ void color_meshlets(pmp::SurfaceMesh &mesh, Cluster &cluster)
 
     std::map<int, pmp::Color> colors;
 
-    for (auto &meshlet : cluster)
+    for (size_t meshlet_id = 0; meshlet_id < cluster.size(); meshlet_id++)
     {
-        for (auto face : get_faces(*meshlet))
+        for (auto face : get_faces(cluster[meshlet_id]))
         {
             int site_id = closest_site[face];
 